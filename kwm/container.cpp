@@ -1,47 +1,84 @@
 #include "container.h"
-#include "space.h"  // Used for the GetActiveSpaceOfScreen functions call; can do this in node.cpp and pass the Space?
+#include "space.h"  // for GetActiveSpaceOfScreen() in CreateLayoutContext()
+
+#include <algorithm>
+#include <cmath>
 
 extern kwm_screen KWMScreen;
+extern kwm_tiling KWMTiling;
+extern kwm_cache KWMCache;
+
+layout_context CreateLayoutContext(screen_info *Screen)
+{
+    return CreateLayoutContext(Screen, GetActiveSpaceOfScreen(Screen));
+}
+
+layout_context CreateLayoutContext(screen_info *Screen, space_info *Space)
+{
+    layout_context Context;
+    Context.X = Screen->X;
+    Context.Y = Screen->Y;
+    Context.Width = Screen->Width;
+    Context.Height = Screen->Height;
+    Context.Offset = Space->Offset;
+    Context.SplitRatio = KWMScreen.SplitRatio;
+    Context.SpawnAsLeftChild = KWMTiling.SpawnAsLeftChild;
+    Context.MasterCount = KWMScreen.MasterCount;
+    Context.MasterRatio = KWMScreen.MasterRatio;
+    Context.Constraints = &KWMCache.WindowConstraints;
+    return Context;
+}
 
-node_container LeftVerticalContainerSplit(screen_info *Screen, const node_container &Container)
+double GetPixelEdge(double Value)
 {
-    space_info *Space = GetActiveSpaceOfScreen(Screen);
+    return std::floor(Value + 0.5);
+}
+
+double GetContainerSplitOffset(double Length, double SplitRatio)
+{
+    return GetPixelEdge(Length * SplitRatio);
+}
 
+node_container LeftVerticalContainerSplit(const layout_context &Context, const node_container &Container)
+{
     node_container LeftContainer = Container;
 
-    LeftContainer.Width = (Container.Width * Container.SplitRatio) - (Space->Offset.VerticalGap / 2);
+    int Gap = GetPixelEdge(Context.Offset.VerticalGap);
+    LeftContainer.Width = GetContainerSplitOffset(Container.Width, Container.SplitRatio) - (Gap / 2);
 
     return LeftContainer;
 }
 
-node_container RightVerticalContainerSplit(screen_info *Screen, const node_container &Container)
+node_container RightVerticalContainerSplit(const layout_context &Context, const node_container &Container)
 {
-    space_info *Space = GetActiveSpaceOfScreen(Screen);
     node_container RightContainer = Container;
 
-    RightContainer.X = Container.X + (Container.Width * Container.SplitRatio) + (Space->Offset.VerticalGap / 2);
-    RightContainer.Width = (Container.Width * (1 - Container.SplitRatio)) - (Space->Offset.VerticalGap / 2);
+    int Gap = GetPixelEdge(Context.Offset.VerticalGap);
+    double Split = GetContainerSplitOffset(Container.Width, Container.SplitRatio) + (Gap - Gap / 2);
+    RightContainer.X = Container.X + Split;
+    RightContainer.Width = Container.Width - Split;
 
     return RightContainer;
 }
 
-node_container UpperHorizontalContainerSplit(screen_info *Screen, const node_container &Container)
+node_container UpperHorizontalContainerSplit(const layout_context &Context, const node_container &Container)
 {
-    space_info *Space = GetActiveSpaceOfScreen(Screen);
     node_container UpperContainer = Container;
 
-    UpperContainer.Height = (Container.Height * Container.SplitRatio) - (Space->Offset.HorizontalGap / 2);
+    int Gap = GetPixelEdge(Context.Offset.HorizontalGap);
+    UpperContainer.Height = GetContainerSplitOffset(Container.Height, Container.SplitRatio) - (Gap / 2);
 
     return UpperContainer;
 }
 
-node_container LowerHorizontalContainerSplit(screen_info *Screen, const node_container &Container)
+node_container LowerHorizontalContainerSplit(const layout_context &Context, const node_container &Container)
 {
-    space_info *Space = GetActiveSpaceOfScreen(Screen);
     node_container LowerContainer = Container;
 
-    LowerContainer.Y = Container.Y + (Container.Height * Container.SplitRatio) + (Space->Offset.HorizontalGap / 2);
-    LowerContainer.Height = (Container.Height * (1 - Container.SplitRatio)) - (Space->Offset.HorizontalGap / 2);
+    int Gap = GetPixelEdge(Context.Offset.HorizontalGap);
+    double Split = GetContainerSplitOffset(Container.Height, Container.SplitRatio) + (Gap - Gap / 2);
+    LowerContainer.Y = Container.Y + Split;
+    LowerContainer.Height = Container.Height - Split;
 
     return LowerContainer;
 }
@@ -51,7 +88,7 @@ split_mode GetOptimalSplitMode(const node_container &Container)
     return (Container.Width / Container.Height) >= 1.618 ? SplitModeVertical : SplitModeHorizontal;
 }
 
-node_container CreateNodeContainer(screen_info *Screen, const node_container &ParentContainer, const container_type &ContainerType)
+node_container CreateNodeContainer(const layout_context &Context, const node_container &ParentContainer, const container_type &ContainerType)
 {
     node_container Container;
 
@@ -59,19 +96,19 @@ node_container CreateNodeContainer(screen_info *Screen, const node_container &Pa
     {
         case ContainerLeft:
         {
-            Container = LeftVerticalContainerSplit(Screen, ParentContainer);
+            Container = LeftVerticalContainerSplit(Context, ParentContainer);
         } break;
         case ContainerRight:
         {
-            Container = RightVerticalContainerSplit(Screen, ParentContainer);
+            Container = RightVerticalContainerSplit(Context, ParentContainer);
         } break;
         case ContainerUpper:
         {
-            Container = UpperHorizontalContainerSplit(Screen, ParentContainer);
+            Container = UpperHorizontalContainerSplit(Context, ParentContainer);
         } break;
         case ContainerLower:
         {
-            Container = LowerHorizontalContainerSplit(Screen, ParentContainer);
+            Container = LowerHorizontalContainerSplit(Context, ParentContainer);
         } break;
         case ContainerRoot:
         default:
@@ -82,7 +119,7 @@ node_container CreateNodeContainer(screen_info *Screen, const node_container &Pa
 
     // FIXME  - (acarlson 02/28/16): Not sure if SplitRatio is correct -- should it be coming from a source already?
     if(Container.SplitRatio == 0)
-        Container.SplitRatio = KWMScreen.SplitRatio;
+        Container.SplitRatio = Context.SplitRatio;
 
     Container.SplitMode = GetOptimalSplitMode(Container);
     Container.Type = ContainerType;
@@ -91,7 +128,7 @@ node_container CreateNodeContainer(screen_info *Screen, const node_container &Pa
 }
 
 // TODO -- can move the node logic up into node.cpp
-void CreateNodeContainerPair(screen_info *Screen, tree_node *Parent, const split_mode &SplitMode)
+void CreateNodeContainerPair(const layout_context &Context, tree_node *Parent, const split_mode &SplitMode)
 {
     Assert(Parent, "CreateNodeContainerPair() Parent")
 
@@ -99,13 +136,13 @@ void CreateNodeContainerPair(screen_info *Screen, tree_node *Parent, const split
     {
         case SplitModeVertical:
         {
-            Parent->LeftChild->Container = CreateNodeContainer(Screen, Parent->Container, ContainerLeft);
-            Parent->RightChild->Container = CreateNodeContainer(Screen, Parent->Container, ContainerRight);
+            Parent->LeftChild->Container = CreateNodeContainer(Context, Parent->Container, ContainerLeft);
+            Parent->RightChild->Container = CreateNodeContainer(Context, Parent->Container, ContainerRight);
         } break;
         case SplitModeHorizontal:
         {
-            Parent->LeftChild->Container = CreateNodeContainer(Screen, Parent->Container, ContainerUpper);
-            Parent->RightChild->Container = CreateNodeContainer(Screen, Parent->Container, ContainerLower);
+            Parent->LeftChild->Container = CreateNodeContainer(Context, Parent->Container, ContainerUpper);
+            Parent->RightChild->Container = CreateNodeContainer(Context, Parent->Container, ContainerLower);
         } break;
         default:
         {
@@ -115,19 +152,80 @@ void CreateNodeContainerPair(screen_info *Screen, tree_node *Parent, const split
     }
 }
 
-void SetRootNodeContainer(screen_info *Screen, node_container* Container)
+void SetRootNodeContainer(const layout_context &Context, node_container* Container)
 {
     Assert(Container, "SetRootNodeContainer()")
 
-    space_info *Space = GetActiveSpaceOfScreen(Screen);
+    double Right = GetPixelEdge(Context.X + Context.Width - Context.Offset.PaddingRight);
+    double Bottom = GetPixelEdge(Context.Y + Context.Height - Context.Offset.PaddingBottom);
 
     Container->Type = ContainerRoot;
-    Container->X = Screen->X + Space->Offset.PaddingLeft;
-    Container->Y = Screen->Y + Space->Offset.PaddingTop;
-    Container->Width = Screen->Width - Space->Offset.PaddingLeft - Space->Offset.PaddingRight;
-    Container->Height = Screen->Height - Space->Offset.PaddingTop - Space->Offset.PaddingBottom;
+    Container->X = GetPixelEdge(Context.X + Context.Offset.PaddingLeft);
+    Container->Y = GetPixelEdge(Context.Y + Context.Offset.PaddingTop);
+    Container->Width = Right - Container->X;
+    Container->Height = Bottom - Container->Y;
     Container->SplitMode = GetOptimalSplitMode(*Container);
-    Container->SplitRatio = KWMScreen.SplitRatio;
+    Container->SplitRatio = Context.SplitRatio;
+}
+
+node_container GetContainerSlice(const layout_context &Context, const node_container &Container, const split_mode &SplitMode, int Count, int Index)
+{
+    Assert(Count > 0 && Index >= 0 && Index < Count, "GetContainerSlice()")
+
+    node_container Slice = Container;
+    bool Vertical = SplitMode == SplitModeVertical;
+
+    int Gap = GetPixelEdge(Vertical ? Context.Offset.VerticalGap : Context.Offset.HorizontalGap);
+    int Length = Vertical ? Container.Width : Container.Height;
+    int Available = std::max(0, Length - Gap * (Count - 1));
+    int Base = Available / Count;
+    int Extra = Available % Count;
+
+    double Offset = Index * (Base + Gap) + std::min(Index, Extra);
+    double Size = Base + (Index < Extra ? 1 : 0);
+    if(Vertical)
+    {
+        Slice.X = Container.X + Offset;
+        Slice.Width = Size;
+    }
+    else
+    {
+        Slice.Y = Container.Y + Offset;
+        Slice.Height = Size;
+    }
+
+    Slice.SplitMode = GetOptimalSplitMode(Slice);
+    return Slice;
+}
+
+node_container CreateMasterStackContainer(const layout_context &Context, const node_container &Root, int Count, int Index)
+{
+    int Masters = std::min(std::max(Context.MasterCount, 0), Count);
+    if(Masters == 0 || Masters == Count)
+        return GetContainerSlice(Context, Root, SplitModeHorizontal, Count, Index);
+
+    node_container Column = Root;
+    Column.SplitRatio = Context.MasterRatio;
+    if(Index < Masters)
+    {
+        Column = LeftVerticalContainerSplit(Context, Column);
+        return GetContainerSlice(Context, Column, SplitModeHorizontal, Masters, Index);
+    }
+
+    Column = RightVerticalContainerSplit(Context, Column);
+    return GetContainerSlice(Context, Column, SplitModeHorizontal, Count - Masters, Index - Masters);
+}
+
+node_container CreateGridContainer(const layout_context &Context, const node_container &Root, int Count, int Index)
+{
+    int Columns = std::ceil(std::sqrt((double)Count));
+    int Rows = (Count + Columns - 1) / Columns;
+    int Row = Index / Columns;
+
+    // The last row may hold fewer windows, they share its full width
+    int RowCount = Row == Rows - 1 ? Count - Row * Columns : Columns;
+    node_container RowContainer = GetContainerSlice(Context, Root, SplitModeHorizontal, Rows, Row);
+    return GetContainerSlice(Context, RowContainer, SplitModeVertical, RowCount, Index % Columns);
 }
 
 void ChangeSplitRatio(double Value)
@@ -139,9 +237,44 @@ void ChangeSplitRatio(double Value)
     }
 }
 
-void ResizeContainer(screen_info *Screen, node_container *Container)
+void ChangeMasterCount(int Value)
 {
-    *Container = CreateNodeContainer(Screen, *Container, Container->Type);
+    if(Value >= 0)
+    {
+        DEBUG("ChangeMasterCount() New Master-Count is " << Value)
+        KWMScreen.MasterCount = Value;
+        MarkMasterSpacePending();
+    }
+}
+
+void ChangeMasterRatio(double Value)
+{
+    if(Value > 0.0 && Value < 1.0)
+    {
+        DEBUG("ChangeMasterRatio() New Master-Ratio is " << Value)
+        KWMScreen.MasterRatio = Value;
+        MarkMasterSpacePending();
+    }
+}
+
+void MarkMasterSpacePending()
+{
+    // Visible spaces are laid out by the next flush, hidden ones once they are shown
+    std::map<unsigned int, screen_info>::iterator Display;
+    for(Display = KWMTiling.DisplayMap.begin(); Display != KWMTiling.DisplayMap.end(); ++Display)
+    {
+        std::map<int, space_info>::iterator It;
+        for(It = Display->second.Space.begin(); It != Display->second.Space.end(); ++It)
+        {
+            if(It->second.Mode == SpaceModeMaster)
+                It->second.PendingLayout = true;
+        }
+    }
+}
+
+void ResizeContainer(const layout_context &Context, node_container *Container)
+{
+    *Container = CreateNodeContainer(Context, *Container, Container->Type);
 }
 
 bool ModifyContainerSplitRatio(node_container *Container, const double &Offset)
@@ -159,3 +292,9 @@ void ToggleContainerSplitMode(node_container *Container)
 {
     Container->SplitMode = Container->SplitMode == SplitModeVertical ? SplitModeHorizontal : SplitModeVertical;
 }
+
+bool IsContainerGeometryEqual(const node_container &A, const node_container &B)
+{
+    return A.X == B.X && A.Y == B.Y &&
+           A.Width == B.Width && A.Height == B.Height;
+}
@@ -4,19 +4,47 @@
 
 #include "types.h"
 
+/* Snapshot everything container math depends on, once per layout pass.
+   The container functions below only read the layout_context, they do not
+   look up the space or read globals.
+    Map:
+        screen_info, space_info -> layout_context
+    Input:
+        Screen - frame of the display
+        Space - offsets of the space, the active space of Screen if omitted
+    Output:
+        layout_context - screen frame, space offsets, default split-ratio,
+                         spawn side and the learned window size constraints
+*/
+layout_context CreateLayoutContext(screen_info *Screen);
+layout_context CreateLayoutContext(screen_info *Screen, space_info *Space);
+
+/* Containers hold whole pixels. The edges of the root container are rounded
+   once, a split line is rounded to a whole pixel and an odd gap gives its
+   extra pixel to the right/lower child, so siblings tile their parent exactly
+   and running the layout again yields the same frames.
+    Input:
+        Value - position or length in points
+        Length, SplitRatio - size of the parent and its split-ratio
+    Output:
+        double - whole pixel value, the offset of the split line for GetContainerSplitOffset()
+*/
+double GetPixelEdge(double Value);
+double GetContainerSplitOffset(double Length, double SplitRatio);
+
 /* Create new node_containers from existing node_containers.
     Map:
         node_container -> node_container
     Inputs:
-        Screen - for current Space offsetting
+        Context - gaps of the space
         Container - start with copy of current Container
     Outputs:
         node_container - split node_container based on the input Node
  */
-node_container LeftVerticalContainerSplit(screen_info *Screen, const node_container &Container);
-node_container RightVerticalContainerSplit(screen_info *Screen, const node_container &Container);
-node_container UpperHorizontalContainerSplit(screen_info *Screen, const node_container &Container);
-node_container LowerHorizontalContainerSplit(screen_info *Screen, const node_container &Container);
+node_container LeftVerticalContainerSplit(const layout_context &Context, const node_container &Container);
+node_container RightVerticalContainerSplit(const layout_context &Context, const node_container &Container);
+node_container UpperHorizontalContainerSplit(const layout_context &Context, const node_container &Container);
+node_container LowerHorizontalContainerSplit(const layout_context &Context, const node_container &Container);
 
 /* Determine whether to split Vertically or Horizontally based on Node->Container.
     Map:
@@ -32,42 +60,69 @@ split_mode GetOptimalSplitMode(const node_container &Container);
     Map:
         node_container -> node_container
     Input:
-        Screen - pass through to create container functions
+        Context - pass through to create container functions
         Parent - Node whose container to use as baseline
         ContainerType - Left/Right/Top/Bottom
     Output:
         node_container - new container dimensions for split.
 */
-node_container CreateNodeContainer(screen_info *Screen, const node_container &ParentContainer, const container_type &ContainerType);
+node_container CreateNodeContainer(const layout_context &Context, const node_container &ParentContainer, const container_type &ContainerType);
 
 /* Mux SplitMode to select which ContainerTypes to use for CreateNodeContainer
     Map:
         node_container -> node_container
     Input:
-        Screen - pass through to  create container functions
+        Context - pass through to create container functions
         Parent - Node whose children containers are being created.
         SplitMode - whether to split horizontally or vertically.
     Output:
         tree_node *Parent - mutate Left and Right children containers
 */
-void CreateNodeContainerPair(screen_info *Screen, tree_node *Parent, const split_mode &SplitMode);
+void CreateNodeContainerPair(const layout_context &Context, tree_node *Parent, const split_mode &SplitMode);
 
 /* Create Container for RootNode
     Map:
         Screen Pos -> node_container
     Input:
-        Screen - for position info
+        Context - screen frame and padding of the space
     Output:
         node_container *Container
 */
-void SetRootNodeContainer(screen_info *Screen, node_container *Container);
+void SetRootNodeContainer(const layout_context &Context, node_container *Container);
+
+/* Tile the windows of a master-stack or grid space. Each window gets its
+   container from its position in the window_ring alone, so a whole space
+   is laid out in a single pass without building a tree.
+    Map:
+        node_container, Count, Index -> node_container
+    Input:
+        Context - gaps of the space, master count and master ratio
+        Container, Root - container to carve up, the root container of the space
+        SplitMode - vertical slices sit side by side, horizontal slices are stacked
+        Count - number of slices or windows
+        Index - zero-based position of the slice or window
+    Output:
+        node_container - whole pixel container, leftover pixels go to the first slices
+*/
+node_container GetContainerSlice(const layout_context &Context, const node_container &Container, const split_mode &SplitMode, int Count, int Index);
+node_container CreateMasterStackContainer(const layout_context &Context, const node_container &Root, int Count, int Index);
+node_container CreateGridContainer(const layout_context &Context, const node_container &Root, int Count, int Index);
 
 /* SET -- KWMScreen.SplitRatio */
 void ChangeSplitRatio(double Value);
 
-/* Mutate existing container based on Screen state */
-void ResizeContainer(screen_info *Screen, node_container *Container);
+/* SET -- KWMScreen.MasterCount, KWMScreen.MasterRatio
+   Every master-stack space on every display is laid out again */
+void ChangeMasterCount(int Value);
+void ChangeMasterRatio(double Value);
+void MarkMasterSpacePending();
+
+/* Mutate existing container based on the layout_context */
+void ResizeContainer(const layout_context &Context, node_container *Container);
 bool ModifyContainerSplitRatio(node_container *Container, const double &Offset);
 
 void ToggleContainerSplitMode(node_container *Container);
+
+/* Compare the position and size of two containers */
+bool IsContainerGeometryEqual(const node_container &A, const node_container &B);
 #endif
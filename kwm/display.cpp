@@ -3,6 +3,7 @@
 #include "tree.h"
 #include "window.h"
 #include "container.h"
+#include "node.h"
 
 extern kwm_screen KWMScreen;
 extern kwm_focus KWMFocus;
@@ -32,7 +33,10 @@ void DisplayReconfigurationCallBack(CGDirectDisplayID Display, CGDisplayChangeSu
             DEBUG("Display has been removed! DisplayID: " << Display)
             std::map<int, space_info>::iterator It;
             for(It = KWMTiling.DisplayMap[Display].Space.begin(); It != KWMTiling.DisplayMap[Display].Space.end(); ++It)
-                DestroyNodeTree(It->second.RootNode, It->second.Mode);
+            {
+                DestroyNodeTree(&It->second);
+                DestroyNodePool(&It->second.Pool);
+            }
 
             if(KWMTiling.DisplayMap[Display].Identifier)
                 CFRelease(KWMTiling.DisplayMap[Display].Identifier);
@@ -53,7 +57,6 @@ screen_info CreateDefaultScreenInfo(int DisplayIndex, int ScreenIndex)
 
     Screen.Identifier = NULL;
     Screen.ID = ScreenIndex;
-    Screen.ForceContainerUpdate = false;
     Screen.ActiveSpace = -1;
     Screen.OldWindowListCount = -1;
 
@@ -71,13 +74,23 @@ void UpdateExistingScreenInfo(screen_info *Screen, int DisplayIndex, int ScreenI
     CGRect DisplayRect = CGDisplayBounds(DisplayIndex);
     Screen->ID = ScreenIndex;
 
+    bool Changed = Screen->X != DisplayRect.origin.x || Screen->Y != DisplayRect.origin.y ||
+                   Screen->Width != DisplayRect.size.width || Screen->Height != DisplayRect.size.height;
+
     Screen->X = DisplayRect.origin.x;
     Screen->Y = DisplayRect.origin.y;
     Screen->Width = DisplayRect.size.width;
     Screen->Height = DisplayRect.size.height;
 
     Screen->Offset = KWMScreen.DefaultOffset;
-    Screen->ForceContainerUpdate = true;
+
+    // Every space of the display is laid out again when it is shown next
+    if(Changed)
+    {
+        std::map<int, space_info>::iterator It;
+        for(It = Screen->Space.begin(); It != Screen->Space.end(); ++It)
+            It->second.PendingLayout = true;
+    }
 }
 
 void GetActiveDisplays()
@@ -138,20 +151,28 @@ screen_info *GetDisplayFromScreenID(unsigned int ID)
 }
 
 screen_info *GetDisplayOfMousePointer()
+{
+    return GetDisplayOfPoint(GetCursorPos());
+}
+
+screen_info *GetDisplayOfPoint(CGPoint Point)
 {
     std::map<unsigned int, screen_info>::iterator It;
     for(It = KWMTiling.DisplayMap.begin(); It != KWMTiling.DisplayMap.end(); ++It)
     {
-        CGPoint Cursor = GetCursorPos();
-        screen_info *Screen = &It->second;
-        if(Cursor.x >= Screen->X && Cursor.x <= Screen->X + Screen->Width &&
-           Cursor.y >= Screen->Y && Cursor.y <= Screen->Y + Screen->Height)
-               return Screen;
+        if(IsPointInsideScreen(Point, &It->second))
+            return &It->second;
     }
 
     return NULL;
 }
 
+bool IsPointInsideScreen(CGPoint Point, screen_info *Screen)
+{
+    return Point.x >= Screen->X && Point.x <= Screen->X + Screen->Width &&
+           Point.y >= Screen->Y && Point.y <= Screen->Y + Screen->Height;
+}
+
 screen_info *GetDisplayOfWindow(window_info *Window)
 {
     if(Window)
@@ -252,27 +273,10 @@ void ChangePaddingOfDisplay(const std::string &Side, int Offset)
             Space->Offset.PaddingBottom += Offset;
     }
 
-    if(Space->RootNode)
-    {
-        if(Space->Mode == SpaceModeBSP)
-        {
-            // TODO - call tree.cpp::ResizeTree which calls SetRootNode and resizes children.
-            ResizeTreeNodes(Screen, Space->RootNode);
-            //SetRootNodeContainer(Screen, &Space->RootNode->Container);
-            //CreateNodeContainers(Screen, Space->RootNode, true);
-        }
-        else if(Space->Mode == SpaceModeMonocle)
-        {
-            tree_node *CurrentNode = Space->RootNode;
-            while(CurrentNode)
-            {
-                SetRootNodeContainer(Screen, &CurrentNode->Container);
-                CurrentNode = CurrentNode->RightChild;
-            }
-        }
-
-        ApplyNodeContainer(Space->RootNode, Space->Mode);
-    }
+    if(Space->RootNode && Space->Mode == SpaceModeBSP)
+        MarkNodeDirty(Space->RootNode);
+    else if(Space->RootNode && IsRingSpaceMode(Space->Mode))
+        Space->PendingLayout = true;
 }
 
 void ChangeGapOfDisplay(const std::string &Side, int Offset)
@@ -292,10 +296,9 @@ void ChangeGapOfDisplay(const std::string &Side, int Offset)
     }
 
     if(Space->RootNode && Space->Mode == SpaceModeBSP)
-    {
-        ResizeTreeNodes(Screen, Space->RootNode);
-        ApplyNodeContainer(Space->RootNode, Space->Mode);
-    }
+        MarkNodeDirty(Space->RootNode);
+    else if(Space->RootNode && Space->Mode != SpaceModeMonocle)
+        Space->PendingLayout = true;
 }
 
 void SetSpaceModeOfDisplay(unsigned int ScreenIndex, std::string Mode)
@@ -304,6 +307,10 @@ void SetSpaceModeOfDisplay(unsigned int ScreenIndex, std::string Mode)
         KWMTiling.DisplayMode[ScreenIndex] = SpaceModeBSP;
     else if(Mode == "monocle")
         KWMTiling.DisplayMode[ScreenIndex] = SpaceModeMonocle;
+    else if(Mode == "master")
+        KWMTiling.DisplayMode[ScreenIndex] = SpaceModeMaster;
+    else if(Mode == "grid")
+        KWMTiling.DisplayMode[ScreenIndex] = SpaceModeGrid;
     else if(Mode == "float")
         KWMTiling.DisplayMode[ScreenIndex] = SpaceModeFloating;
 }
@@ -448,19 +455,22 @@ container_offset CreateDefaultScreenOffset()
 
 void UpdateActiveScreen()
 {
-    screen_info *Screen = GetDisplayOfMousePointer();
-    if(KWMScreen.Current != Screen)
+    UpdateActiveScreen(GetCursorPos());
+}
+
+void UpdateActiveScreen(CGPoint Cursor)
+{
+    // The cursor mostly moves within the active display, which needs no lookup
+    if(KWMScreen.Current && IsPointInsideScreen(Cursor, KWMScreen.Current))
+        return;
+
+    screen_info *Screen = GetDisplayOfPoint(Cursor);
+    if(Screen && KWMScreen.Current != Screen)
     {
         DEBUG("UpdateActiveScreen() Active Display Changed")
 
         ClearMarkedWindow();
         GiveFocusToScreen(Screen->ID, NULL, true);
-
-        if(Screen->ForceContainerUpdate)
-        {
-            space_info *Space = GetActiveSpaceOfScreen(Screen);
-            ApplyNodeContainer(Space->RootNode, Space->Mode);
-            Screen->ForceContainerUpdate = false;
-        }
+        FlushTreeLayout(Screen);
     }
 }
@@ -14,6 +14,8 @@ int GetIndexOfPrevScreen();
 
 screen_info *GetDisplayFromScreenID(unsigned int ID);
 screen_info *GetDisplayOfMousePointer();
+screen_info *GetDisplayOfPoint(CGPoint Point);
+bool IsPointInsideScreen(CGPoint Point, screen_info *Screen);
 screen_info *GetDisplayOfWindow(window_info *Window);
 
 std::vector<window_info*> GetAllWindowsOnDisplay(int ScreenIndex);
@@ -24,7 +26,11 @@ void MoveWindowToDisplay(window_info *Window, int Shift, bool Relative);
 void SetSpaceModeOfDisplay(unsigned int ScreenIndex, std::string Mode);
 space_tiling_option GetSpaceModeOfDisplay(unsigned int ScreenIndex);
 void GiveFocusToScreen(int ScreenIndex, tree_node *Focus, bool Mouse);
+/* Give focus to the display under the cursor when it changed.
+   The mouse-move handler passes the location of its event, so the
+   cursor is never read back from the system while it moves. */
 void UpdateActiveScreen();
+void UpdateActiveScreen(CGPoint Cursor);
 
 container_offset CreateDefaultScreenOffset();
 screen_info CreateDefaultScreenInfo(int DisplayIndex, int ScreenIndex);
@@ -0,0 +1,237 @@
+#include "geometry.h"
+
+#include <algorithm>
+#include <cmath>
+#include <climits>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+
+// SSE2 has no 32-bit min/max, select through a compare mask instead
+inline __m128i SelectInt32(__m128i Mask, __m128i A, __m128i B)
+{
+    return _mm_or_si128(_mm_and_si128(Mask, A), _mm_andnot_si128(Mask, B));
+}
+
+inline __m128i MaxInt32(__m128i A, __m128i B)
+{
+    return SelectInt32(_mm_cmpgt_epi32(A, B), A, B);
+}
+
+inline __m128i MinInt32(__m128i A, __m128i B)
+{
+    return SelectInt32(_mm_cmplt_epi32(A, B), A, B);
+}
+
+// Lanes 0-1 or 2-3 of a 32-bit vector as doubles, or as a 64-bit wide mask
+inline __m128d LowInt32ToDouble(__m128i A)
+{
+    return _mm_cvtepi32_pd(A);
+}
+
+inline __m128d HighInt32ToDouble(__m128i A)
+{
+    return _mm_cvtepi32_pd(_mm_shuffle_epi32(A, _MM_SHUFFLE(1, 0, 3, 2)));
+}
+
+inline __m128d LowMaskToDouble(__m128i Mask)
+{
+    return _mm_castsi128_pd(_mm_unpacklo_epi32(Mask, Mask));
+}
+
+inline __m128d HighMaskToDouble(__m128i Mask)
+{
+    return _mm_castsi128_pd(_mm_unpackhi_epi32(Mask, Mask));
+}
+#endif
+
+void BuildWindowGeometry(const std::vector<window_info> &Windows, window_geometry *Geometry)
+{
+    std::size_t Count = Windows.size();
+    Geometry->X.resize(Count);
+    Geometry->Y.resize(Count);
+    Geometry->Width.resize(Count);
+    Geometry->Height.resize(Count);
+
+    for(std::size_t Index = 0; Index < Count; ++Index)
+    {
+        Geometry->X[Index] = Windows[Index].X;
+        Geometry->Y[Index] = Windows[Index].Y;
+        Geometry->Width[Index] = Windows[Index].Width;
+        Geometry->Height[Index] = Windows[Index].Height;
+    }
+}
+
+int FindRectAtPoint(const window_geometry &Geometry, int X, int Y)
+{
+    std::size_t Count = Geometry.X.size();
+    std::size_t Index = 0;
+
+#ifdef __SSE2__
+    __m128i PointX = _mm_set1_epi32(X);
+    __m128i PointY = _mm_set1_epi32(Y);
+    for(; Index + 4 <= Count; Index += 4)
+    {
+        __m128i Left = _mm_loadu_si128((const __m128i*)&Geometry.X[Index]);
+        __m128i Top = _mm_loadu_si128((const __m128i*)&Geometry.Y[Index]);
+        __m128i Right = _mm_add_epi32(Left, _mm_loadu_si128((const __m128i*)&Geometry.Width[Index]));
+        __m128i Bottom = _mm_add_epi32(Top, _mm_loadu_si128((const __m128i*)&Geometry.Height[Index]));
+
+        __m128i Outside = _mm_or_si128(_mm_or_si128(_mm_cmplt_epi32(PointX, Left), _mm_cmpgt_epi32(PointX, Right)),
+                                       _mm_or_si128(_mm_cmplt_epi32(PointY, Top), _mm_cmpgt_epi32(PointY, Bottom)));
+
+        int Inside = ~_mm_movemask_ps(_mm_castsi128_ps(Outside)) & 0xF;
+        if(Inside)
+            return Index + __builtin_ctz(Inside);
+    }
+#endif
+
+    for(; Index < Count; ++Index)
+    {
+        if(X >= Geometry.X[Index] &&
+           X <= Geometry.X[Index] + Geometry.Width[Index] &&
+           Y >= Geometry.Y[Index] &&
+           Y <= Geometry.Y[Index] + Geometry.Height[Index])
+            return Index;
+    }
+
+    return -1;
+}
+
+double GetDirectedRectDistance(const window_info &Match, int X, int Y, int Width, int Height,
+                               int Degrees, bool Wrap, int ScreenWidth, int ScreenHeight)
+{
+    bool InDirection = false;
+    if(Wrap)
+    {
+        if(Degrees == 0 || Degrees == 180)
+            InDirection = Match.Y != Y && std::max(Match.X, X) < std::min(X + Width, Match.X + Match.Width);
+        else if(Degrees == 90 || Degrees == 270)
+            InDirection = Match.X != X && std::max(Match.Y, Y) < std::min(Y + Height, Match.Y + Match.Height);
+    }
+    else
+    {
+        if(Degrees == 0)
+            InDirection = Y + Height < Match.Y;
+        else if(Degrees == 90)
+            InDirection = X > Match.X + Match.Width;
+        else if(Degrees == 180)
+            InDirection = Y > Match.Y + Match.Height;
+        else if(Degrees == 270)
+            InDirection = X + Width < Match.X;
+    }
+
+    if(!InDirection)
+        return INT_MAX;
+
+    int MatchX = Match.X + Match.Width / 2;
+    int MatchY = Match.Y + Match.Height / 2;
+    if(Wrap)
+    {
+        int CenterX = X + Width / 2;
+        int CenterY = Y + Height / 2;
+        if(Degrees == 0 && MatchY < CenterY)
+            Y -= ScreenHeight;
+        else if(Degrees == 180 && MatchY > CenterY)
+            Y += ScreenHeight;
+        else if(Degrees == 90 && MatchX > CenterX)
+            X += ScreenWidth;
+        else if(Degrees == 270 && MatchX < CenterX)
+            X -= ScreenWidth;
+    }
+
+    int DistX = X + Width / 2 - MatchX;
+    int DistY = Y + Height / 2 - MatchY;
+    int ScoreX = DistX >= -15 && DistX <= 15 ? 1 : 11;
+    int ScoreY = DistY >= -10 && DistY <= 10 ? 1 : 22;
+    return std::sqrt((double)DistX * DistX + (double)DistY * DistY) + ScoreX * ScoreY;
+}
+
+void GetDirectedRectDistances(const window_geometry &Geometry, const window_info &Match,
+                              int Degrees, bool Wrap, int ScreenWidth, int ScreenHeight,
+                              double *Distances)
+{
+    std::size_t Count = Geometry.X.size();
+    std::size_t Index = 0;
+
+#ifdef __SSE2__
+    __m128i MatchLeft = _mm_set1_epi32(Match.X);
+    __m128i MatchTop = _mm_set1_epi32(Match.Y);
+    __m128i MatchRight = _mm_set1_epi32(Match.X + Match.Width);
+    __m128i MatchBottom = _mm_set1_epi32(Match.Y + Match.Height);
+    __m128i MatchX = _mm_set1_epi32(Match.X + Match.Width / 2);
+    __m128i MatchY = _mm_set1_epi32(Match.Y + Match.Height / 2);
+    __m128i ShiftX = _mm_set1_epi32(ScreenWidth);
+    __m128i ShiftY = _mm_set1_epi32(ScreenHeight);
+    __m128d NotInDirection = _mm_set1_pd(INT_MAX);
+
+    for(; Index + 4 <= Count; Index += 4)
+    {
+        __m128i Left = _mm_loadu_si128((const __m128i*)&Geometry.X[Index]);
+        __m128i Top = _mm_loadu_si128((const __m128i*)&Geometry.Y[Index]);
+        __m128i Width = _mm_loadu_si128((const __m128i*)&Geometry.Width[Index]);
+        __m128i Height = _mm_loadu_si128((const __m128i*)&Geometry.Height[Index]);
+        __m128i Right = _mm_add_epi32(Left, Width);
+        __m128i Bottom = _mm_add_epi32(Top, Height);
+        __m128i HalfWidth = _mm_srai_epi32(Width, 1);
+        __m128i HalfHeight = _mm_srai_epi32(Height, 1);
+
+        __m128i InDirection = _mm_setzero_si128();
+        if(Wrap)
+        {
+            if(Degrees == 0 || Degrees == 180)
+                InDirection = _mm_andnot_si128(_mm_cmpeq_epi32(MatchTop, Top),
+                                               _mm_cmplt_epi32(MaxInt32(MatchLeft, Left), MinInt32(Right, MatchRight)));
+            else if(Degrees == 90 || Degrees == 270)
+                InDirection = _mm_andnot_si128(_mm_cmpeq_epi32(MatchLeft, Left),
+                                               _mm_cmplt_epi32(MaxInt32(MatchTop, Top), MinInt32(Bottom, MatchBottom)));
+
+            __m128i CenterX = _mm_add_epi32(Left, HalfWidth);
+            __m128i CenterY = _mm_add_epi32(Top, HalfHeight);
+            if(Degrees == 0)
+                Top = _mm_sub_epi32(Top, _mm_and_si128(_mm_cmplt_epi32(MatchY, CenterY), ShiftY));
+            else if(Degrees == 180)
+                Top = _mm_add_epi32(Top, _mm_and_si128(_mm_cmpgt_epi32(MatchY, CenterY), ShiftY));
+            else if(Degrees == 90)
+                Left = _mm_add_epi32(Left, _mm_and_si128(_mm_cmpgt_epi32(MatchX, CenterX), ShiftX));
+            else if(Degrees == 270)
+                Left = _mm_sub_epi32(Left, _mm_and_si128(_mm_cmplt_epi32(MatchX, CenterX), ShiftX));
+        }
+        else
+        {
+            if(Degrees == 0)
+                InDirection = _mm_cmplt_epi32(Bottom, MatchTop);
+            else if(Degrees == 90)
+                InDirection = _mm_cmpgt_epi32(Left, MatchRight);
+            else if(Degrees == 180)
+                InDirection = _mm_cmpgt_epi32(Top, MatchBottom);
+            else if(Degrees == 270)
+                InDirection = _mm_cmplt_epi32(Right, MatchLeft);
+        }
+
+        __m128i DistX = _mm_sub_epi32(_mm_add_epi32(Left, HalfWidth), MatchX);
+        __m128i DistY = _mm_sub_epi32(_mm_add_epi32(Top, HalfHeight), MatchY);
+        __m128i NearX = _mm_andnot_si128(_mm_cmpgt_epi32(DistX, _mm_set1_epi32(15)), _mm_cmpgt_epi32(DistX, _mm_set1_epi32(-16)));
+        __m128i NearY = _mm_andnot_si128(_mm_cmpgt_epi32(DistY, _mm_set1_epi32(10)), _mm_cmpgt_epi32(DistY, _mm_set1_epi32(-11)));
+        __m128i ScoreX = _mm_sub_epi32(_mm_set1_epi32(11), _mm_and_si128(NearX, _mm_set1_epi32(10)));
+        __m128i ScoreY = _mm_sub_epi32(_mm_set1_epi32(22), _mm_and_si128(NearY, _mm_set1_epi32(21)));
+
+        for(int Half = 0; Half < 2; ++Half)
+        {
+            __m128d X = Half ? HighInt32ToDouble(DistX) : LowInt32ToDouble(DistX);
+            __m128d Y = Half ? HighInt32ToDouble(DistY) : LowInt32ToDouble(DistY);
+            __m128d Weight = _mm_mul_pd(Half ? HighInt32ToDouble(ScoreX) : LowInt32ToDouble(ScoreX),
+                                        Half ? HighInt32ToDouble(ScoreY) : LowInt32ToDouble(ScoreY));
+            __m128d Dist = _mm_add_pd(_mm_sqrt_pd(_mm_add_pd(_mm_mul_pd(X, X), _mm_mul_pd(Y, Y))), Weight);
+
+            __m128d Mask = Half ? HighMaskToDouble(InDirection) : LowMaskToDouble(InDirection);
+            _mm_storeu_pd(&Distances[Index + Half * 2], _mm_or_pd(_mm_and_pd(Mask, Dist), _mm_andnot_pd(Mask, NotInDirection)));
+        }
+    }
+#endif
+
+    for(; Index < Count; ++Index)
+        Distances[Index] = GetDirectedRectDistance(Match, Geometry.X[Index], Geometry.Y[Index],
+                                                   Geometry.Width[Index], Geometry.Height[Index],
+                                                   Degrees, Wrap, ScreenWidth, ScreenHeight);
+}
@@ -0,0 +1,47 @@
+/* Functions that operate on packed window rectangles */
+
+#ifndef GEOMETRY_H
+#define GEOMETRY_H
+
+#include "types.h"
+
+/* Copy the frames of a window list into structure-of-arrays form.
+   Index i of every array belongs to Windows[i], so results map back to the list.
+    Map:
+        std::vector<window_info> -> window_geometry
+    Input:
+        Windows - window list, e.g. KWMTiling.FocusLst or KWMTiling.WindowLst
+    Output:
+        window_geometry *Geometry - replaced by the frames of Windows
+*/
+void BuildWindowGeometry(const std::vector<window_info> &Windows, window_geometry *Geometry);
+
+/* Find the first rectangle containing a point, edges included.
+   Four rectangles are tested per step on SSE2, one at a time otherwise.
+    Input:
+        Geometry - rectangles in z-order
+        X, Y - point, whole pixels
+    Output:
+        int - index of the first rectangle containing the point, -1 if none
+*/
+int FindRectAtPoint(const window_geometry &Geometry, int X, int Y);
+
+/* Score every rectangle as a directional target of Match, the vectorized form
+   of WindowIsInDirection() followed by GetWindowDistance(). Wrapped candidates
+   are moved by one screen first. GetDirectedRectDistance() scores one rectangle.
+    Input:
+        Geometry - candidate rectangles
+        Match - frame of the window to move away from
+        Degrees, Wrap - direction, and whether to wrap around the screen
+        ScreenWidth, ScreenHeight - offset of wrapped candidates
+    Output:
+        double *Distances - one weighted distance per rectangle,
+                            INT_MAX for rectangles that are not in Degrees
+*/
+void GetDirectedRectDistances(const window_geometry &Geometry, const window_info &Match,
+                              int Degrees, bool Wrap, int ScreenWidth, int ScreenHeight,
+                              double *Distances);
+double GetDirectedRectDistance(const window_info &Match, int X, int Y, int Width, int Height,
+                               int Degrees, bool Wrap, int ScreenWidth, int ScreenHeight);
+
+#endif
@@ -19,6 +19,7 @@ extern kwm_toggles KWMToggles;
 extern kwm_focus KWMFocus;
 extern kwm_mode KWMMode;
 extern kwm_tiling KWMTiling;
+extern kwm_cache KWMCache;
 extern kwm_border FocusedBorder;
 extern kwm_border MarkedBorder;
 extern kwm_border PrefixBorder;
@@ -157,6 +158,10 @@ void KwmConfigCommand(std::vector<std::string> &Tokens)
             KWMMode.Space = SpaceModeBSP;
         else if(Tokens[2] == "monocle")
             KWMMode.Space = SpaceModeMonocle;
+        else if(Tokens[2] == "master")
+            KWMMode.Space = SpaceModeMaster;
+        else if(Tokens[2] == "grid")
+            KWMMode.Space = SpaceModeGrid;
         else if(Tokens[2] == "float")
             KWMMode.Space = SpaceModeFloating;
     }
@@ -176,6 +181,18 @@ void KwmConfigCommand(std::vector<std::string> &Tokens)
             else if(Tokens[3] == "enable")
                 KWMToggles.StandbyOnFloat = true;
         }
+        else if(Tokens[2] == "mouse-interval")
+        {
+            double Interval = ConvertStringToDouble(Tokens[3]);
+            if(Interval >= 0)
+                KWMFocus.MouseInterval = Interval;
+        }
+        else if(Tokens[2] == "mouse-dwell")
+        {
+            double Dwell = ConvertStringToDouble(Tokens[3]);
+            if(Dwell >= 0)
+                KWMFocus.MouseDwell = Dwell;
+        }
         else if(Tokens[2] == "toggle")
         {
             if(KWMMode.Focus == FocusModeDisabled)
@@ -231,6 +248,14 @@ void KwmConfigCommand(std::vector<std::string> &Tokens)
     {
         ChangeSplitRatio(ConvertStringToDouble(Tokens[2]));
     }
+    else if(Tokens[1] == "master-count")
+    {
+        ChangeMasterCount(ConvertStringToInt(Tokens[2]));
+    }
+    else if(Tokens[1] == "master-ratio")
+    {
+        ChangeMasterRatio(ConvertStringToDouble(Tokens[2]));
+    }
     else if(Tokens[1] == "screen")
     {
         SetSpaceModeOfDisplay(ConvertStringToInt(Tokens[2]), Tokens[3]);
@@ -281,6 +306,17 @@ void KwmReadCommand(std::vector<std::string> &Tokens, int ClientSockFD)
         Output.erase(Output.find_last_not_of('0') + 1, std::string::npos);
         KwmWriteToSocket(ClientSockFD, Output);
     }
+    else if(Tokens[1] == "master-ratio")
+    {
+        std::string Output = std::to_string(KWMScreen.MasterRatio);
+        Output.erase(Output.find_last_not_of('0') + 1, std::string::npos);
+        KwmWriteToSocket(ClientSockFD, Output);
+    }
+    else if(Tokens[1] == "master-count")
+    {
+        std::string Output = std::to_string(KWMScreen.MasterCount);
+        KwmWriteToSocket(ClientSockFD, Output);
+    }
     else if(Tokens[1] == "split-mode")
     {
         std::string Output;
@@ -299,7 +335,7 @@ void KwmReadCommand(std::vector<std::string> &Tokens, int ClientSockFD)
             {
                 int WindowID = ConvertStringToInt(Tokens[2]);
                 space_info *Space = GetActiveSpaceOfScreen(KWMScreen.Current);
-                tree_node *Node = GetNodeFromWindowID(Space->RootNode, WindowID, Space->Mode);
+                tree_node *Node = GetNodeFromWindowID(Space, WindowID);
                 if(Node)
                 {
                     if(Node->Container.SplitMode == SplitModeVertical)
@@ -341,6 +377,10 @@ void KwmReadCommand(std::vector<std::string> &Tokens, int ClientSockFD)
             Output = "bsp";
         else if(KWMMode.Space == SpaceModeMonocle)
             Output = "monocle";
+        else if(KWMMode.Space == SpaceModeMaster)
+            Output = "master";
+        else if(KWMMode.Space == SpaceModeGrid)
+            Output = "grid";
         else
             Output = "float";
 
@@ -398,8 +438,8 @@ void KwmReadCommand(std::vector<std::string> &Tokens, int ClientSockFD)
         {
             int WindowID = ConvertStringToInt(Tokens[2]);
             space_info *Space = GetActiveSpaceOfScreen(KWMScreen.Current);
-            tree_node *Node = GetNodeFromWindowID(Space->RootNode, WindowID, Space->Mode);
-            tree_node *FocusedNode = GetNodeFromWindowID(Space->RootNode, KWMFocus.Window->WID, Space->Mode);
+            tree_node *Node = GetNodeFromWindowID(Space, WindowID);
+            tree_node *FocusedNode = GetNodeFromWindowID(Space, KWMFocus.Window->WID);
 
             if(Node && FocusedNode)
                 Output = FocusedNode->Parent == Node->Parent ? "1" : "0";
@@ -414,7 +454,7 @@ void KwmReadCommand(std::vector<std::string> &Tokens, int ClientSockFD)
         {
             int WindowID = ConvertStringToInt(Tokens[2]);
             space_info *Space = GetActiveSpaceOfScreen(KWMScreen.Current);
-            tree_node *Node = GetNodeFromWindowID(Space->RootNode, WindowID, Space->Mode);
+            tree_node *Node = GetNodeFromWindowID(Space, WindowID);
 
             if(Node)
                 Output = IsLeftLeaf(Node) ? "left" : "right";
@@ -422,6 +462,24 @@ void KwmReadCommand(std::vector<std::string> &Tokens, int ClientSockFD)
 
         KwmWriteToSocket(ClientSockFD, Output);
     }
+    else if(Tokens[1] == "stats")
+    {
+        std::string Output;
+        if(IsSpaceInitializedForScreen(KWMScreen.Current))
+        {
+            space_info *Space = GetActiveSpaceOfScreen(KWMScreen.Current);
+            Output += "nodes " + std::to_string(Space->Pool.NodeCount) + "\n";
+            Output += "node-allocations " + std::to_string(Space->Pool.Allocations) + "\n";
+            Output += "node-heap-allocations " + std::to_string(Space->Pool.HeapAllocations) + "\n";
+        }
+
+        Output += "window-resizes-issued " + std::to_string(KWMCache.ResizesIssued) + "\n";
+        Output += "window-resizes-skipped " + std::to_string(KWMCache.ResizesSkipped) + "\n";
+        Output += "mouse-moves-coalesced " + std::to_string(KWMCache.MouseMovesCoalesced) + "\n";
+        Output += "focus-changes-deferred " + std::to_string(KWMCache.FocusChangesDeferred);
+
+        KwmWriteToSocket(ClientSockFD, Output);
+    }
     else if(Tokens[1] == "windows")
     {
         std::string Output;
@@ -459,7 +517,7 @@ void KwmWindowCommand(std::vector<std::string> &Tokens)
         if(Tokens[2] == "split")
         {
             space_info *Space = GetActiveSpaceOfScreen(KWMScreen.Current);
-            tree_node *Node = GetNodeFromWindowID(Space->RootNode, KWMFocus.Window->WID, Space->Mode);
+            tree_node *Node = GetNodeFromWindowID(Space, KWMFocus.Window->WID);
             ToggleSubtreeSplitMode(KWMScreen.Current, Node->Parent);
         }
         else if(Tokens[2] == "reduce" || Tokens[2] == "expand")
@@ -571,18 +629,31 @@ void KwmTreeCommand(std::vector<std::string> &Tokens)
             space_info *Space = GetActiveSpaceOfScreen(KWMScreen.Current);
             if(Space->Mode == SpaceModeBSP)
             {
+                RecordTreeLayout(Space);
                 RotateTree(Space->RootNode, ConvertStringToInt(Tokens[2]));
-                ResizeTreeNodes(KWMScreen.Current, Space->RootNode);
-                ApplyNodeContainer(Space->RootNode, Space->Mode);
+                MarkNodeDirty(Space->RootNode);
             }
         }
     }
+    else if(Tokens[1] == "equalize" || Tokens[1] == "rebalance")
+    {
+        space_info *Space = GetActiveSpaceOfScreen(KWMScreen.Current);
+        if(Space->Mode == SpaceModeBSP)
+        {
+            RecordTreeLayout(Space);
+            if(Tokens[1] == "equalize")
+                EqualizeBSPTree(Space);
+            else
+                RebalanceBSPTree(KWMScreen.Current, Space);
+        }
+    }
     else if(Tokens[1] == "-c")
     {
         if(Tokens[2] == "refresh")
         {
             space_info *Space = GetActiveSpaceOfScreen(KWMScreen.Current);
-            ApplyNodeContainer(Space->RootNode, Space->Mode);
+            ClearWindowFrameCache();
+            ApplyNodeContainer(Space);
         }
     }
     else if(Tokens[1] == "save")
@@ -593,6 +664,14 @@ void KwmTreeCommand(std::vector<std::string> &Tokens)
     {
         LoadBSPTreeFromFile(KWMScreen.Current, Tokens[2]);
     }
+    else if(Tokens[1] == "undo")
+    {
+        UndoTreeLayout(KWMScreen.Current);
+    }
+    else if(Tokens[1] == "redo")
+    {
+        RedoTreeLayout(KWMScreen.Current);
+    }
 }
 
 void KwmScreenCommand(std::vector<std::string> &Tokens)
@@ -641,6 +720,10 @@ void KwmSpaceCommand(std::vector<std::string> &Tokens)
             TileFocusedSpace(SpaceModeBSP);
         else if(Tokens[2] == "monocle")
             TileFocusedSpace(SpaceModeMonocle);
+        else if(Tokens[2] == "master")
+            TileFocusedSpace(SpaceModeMaster);
+        else if(Tokens[2] == "grid")
+            TileFocusedSpace(SpaceModeGrid);
     }
     else if(Tokens[1] == "-r")
     {
@@ -717,4 +800,6 @@ void KwmInterpretCommand(std::string Message, int ClientSockFD)
         KwmBindCommand(Tokens);
     else if(Tokens[0] == "unbind")
         KwmRemoveHotkey(Tokens[1]);
+
+    FlushTreeLayout();
 }
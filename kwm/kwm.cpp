@@ -67,12 +67,9 @@ CGEventRef CGEventCallback(CGEventTapProxy Proxy, CGEventType Type, CGEventRef E
         } break;
         case kCGEventMouseMoved:
         {
-            UpdateActiveScreen();
-
-            if(KWMMode.Focus != FocusModeDisabled &&
-               KWMMode.Focus != FocusModeStandby &&
-               !IsActiveSpaceFloating())
-                FocusWindowBelowCursor();
+            CGPoint Cursor = CGEventGetLocation(Event);
+            if(!IsMouseMoveCoalesced(Cursor))
+                FocusWindowFollowingMouse(Cursor);
         } break;
     }
 
@@ -95,6 +92,7 @@ void * KwmWindowMonitor(void*)
     {
         pthread_mutex_lock(&KWMThread.Lock);
         CheckPrefixTimeout();
+        CheckPendingMouseMove();
 
         if(!IsSpaceTransitionInProgress() &&
            IsActiveSpaceManaged())
@@ -232,6 +230,8 @@ void KwmInit()
     signal(SIGTRAP, SignalHandler);
 
     KWMScreen.SplitRatio = 0.5;
+    KWMScreen.MasterCount = 1;
+    KWMScreen.MasterRatio = 0.5;
     KWMScreen.SplitMode = SplitModeOptimal;
     KWMScreen.MarkedWindow = -1;
     KWMScreen.PrevSpace = -1;
@@ -252,6 +252,10 @@ void KwmInit()
     KWMHotkeys.Prefix.Active = false;
     KWMHotkeys.Prefix.Timeout = 0.75;
 
+    KWMFocus.MouseInterval = 0.02;
+    KWMFocus.MouseDwell = 0;
+    KWMFocus.DwellWindowID = -1;
+
     FocusedBorder.Radius = -1;
     MarkedBorder.Radius = -1;
     PrefixBorder.Radius = -1;
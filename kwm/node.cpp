@@ -1,66 +1,150 @@
 #include "node.h"
 #include "container.h"
+#include "space.h"
 #include "window.h" // TODO remove ResizeWindowToContainerSize and get rid of this include.
 
-extern kwm_screen KWMScreen;
-extern kwm_tiling KWMTiling;
+#include <algorithm>
 
-tree_node *CreateRootNode(screen_info *Screen)
+tree_node *AllocateNode(node_pool *Pool)
 {
+    Assert(Pool, "AllocateNode()")
+
+    tree_node *Node = NULL;
+    if(Pool->FreeList)
+    {
+        Node = Pool->FreeList;
+        Pool->FreeList = Node->Parent;
+    }
+    else
+    {
+        if(Pool->Index == NODE_POOL_CHUNK_SIZE)
+        {
+            ++Pool->Chunk;
+            Pool->Index = 0;
+        }
+
+        if(Pool->Chunk == Pool->Chunks.size())
+        {
+            tree_node *Chunk = (tree_node*) malloc(sizeof(tree_node) * NODE_POOL_CHUNK_SIZE);
+            Pool->Chunks.push_back(Chunk);
+            ++Pool->HeapAllocations;
+            DEBUG("AllocateNode() Node pool grew to " << Pool->Chunks.size() << " chunks")
+        }
+
+        Node = &Pool->Chunks[Pool->Chunk][Pool->Index++];
+    }
+
     tree_node Clear = {0};
-    tree_node *RootNode = (tree_node*) malloc(sizeof(tree_node));
-    *RootNode = Clear;
+    *Node = Clear;
+
+    ++Pool->NodeCount;
+    ++Pool->Allocations;
+    return Node;
+}
+
+void FreeNode(node_pool *Pool, tree_node *Node)
+{
+    if(Pool && Node)
+    {
+        Node->Parent = Pool->FreeList;
+        Pool->FreeList = Node;
+        --Pool->NodeCount;
+    }
+}
+
+void ResetNodePool(node_pool *Pool)
+{
+    Pool->FreeList = NULL;
+    Pool->Chunk = 0;
+    Pool->Index = 0;
+    Pool->NodeCount = 0;
+}
+
+void DestroyNodePool(node_pool *Pool)
+{
+    for(std::size_t ChunkIndex = 0; ChunkIndex < Pool->Chunks.size(); ++ChunkIndex)
+        free(Pool->Chunks[ChunkIndex]);
+
+    Pool->Chunks.clear();
+    ResetNodePool(Pool);
+}
+
+void SetNodeWindowID(space_info *Space, tree_node *Node, int WindowID)
+{
+    Assert(Space, "SetNodeWindowID() Space")
+    Assert(Node, "SetNodeWindowID() Node")
+
+    if(Node->WindowID != -1)
+    {
+        std::unordered_map<int, tree_node*>::iterator It = Space->WindowNodes.find(Node->WindowID);
+        if(It != Space->WindowNodes.end() && It->second == Node)
+            Space->WindowNodes.erase(It);
+    }
+
+    Node->WindowID = WindowID;
+    if(WindowID != -1)
+        Space->WindowNodes[WindowID] = Node;
+
+    ++Space->NeighbourGeneration;
+}
+
+tree_node *CreateRootNode(const layout_context &Context, space_info *Space)
+{
+    tree_node *RootNode = AllocateNode(&Space->Pool);
 
     RootNode->WindowID = -1;
     RootNode->Parent = NULL;
     RootNode->LeftChild = NULL;
     RootNode->RightChild = NULL;
-    SetRootNodeContainer(Screen, &RootNode->Container);
+    RootNode->PrevLeaf = NULL;
+    RootNode->NextLeaf = NULL;
+    RootNode->LeafCount = 1;
+    SetRootNodeContainer(Context, &RootNode->Container);
 
     return RootNode;
 }
 
-tree_node *CreateLeafNode(screen_info *Screen, tree_node *Parent, int WindowID, const container_type &ContainerType)
+tree_node *CreateLeafNode(const layout_context &Context, space_info *Space, tree_node *Parent, int WindowID, const container_type &ContainerType)
 {
     Assert(Parent, "CreateLeafNode()")
 
-    tree_node Clear = {0};
-    tree_node *Leaf = (tree_node*) malloc(sizeof(tree_node));
-    *Leaf = Clear;
+    tree_node *Leaf = AllocateNode(&Space->Pool);
 
     Leaf->Parent = Parent;
-    Leaf->WindowID = WindowID;
+    Leaf->WindowID = -1;
+    SetNodeWindowID(Space, Leaf, WindowID);
 
-    Leaf->Container = CreateNodeContainer(Screen, Parent->Container, ContainerType);
+    Leaf->Container = CreateNodeContainer(Context, Parent->Container, ContainerType);
 
     Leaf->LeftChild = NULL;
     Leaf->RightChild = NULL;
+    Leaf->LeafCount = 1;
 
     return Leaf;
 }
 
-void CreateLeafNodePair(screen_info *Screen, tree_node *Parent, int FirstWindowID, int SecondWindowID, const split_mode &SplitMode)
+void CreateLeafNodePair(const layout_context &Context, space_info *Space, tree_node *Parent, int FirstWindowID, int SecondWindowID, const split_mode &SplitMode)
 {
     Assert(Parent, "CreateLeafNodePair()")
 
-    Parent->WindowID = -1;
+    SetNodeWindowID(Space, Parent, -1);
     Parent->Container.SplitMode = SplitMode == SplitModeOptimal ? GetOptimalSplitMode(Parent->Container) : SplitMode;
-    Parent->Container.SplitRatio = KWMScreen.SplitRatio;
+    Parent->Container.SplitRatio = Context.SplitRatio;
 
-    int LeftWindowID = KWMTiling.SpawnAsLeftChild ? SecondWindowID : FirstWindowID;
-    int RightWindowID = KWMTiling.SpawnAsLeftChild ? FirstWindowID : SecondWindowID;
+    int LeftWindowID = Context.SpawnAsLeftChild ? SecondWindowID : FirstWindowID;
+    int RightWindowID = Context.SpawnAsLeftChild ? FirstWindowID : SecondWindowID;
 
     switch(Parent->Container.SplitMode)
     {
         case SplitModeVertical:
         {
-            Parent->LeftChild = CreateLeafNode(Screen, Parent, LeftWindowID, ContainerLeft);
-            Parent->RightChild = CreateLeafNode(Screen, Parent, RightWindowID, ContainerRight);
+            Parent->LeftChild = CreateLeafNode(Context, Space, Parent, LeftWindowID, ContainerLeft);
+            Parent->RightChild = CreateLeafNode(Context, Space, Parent, RightWindowID, ContainerRight);
         } break;
         case SplitModeHorizontal:
         {
-            Parent->LeftChild = CreateLeafNode(Screen, Parent, LeftWindowID, ContainerUpper);
-            Parent->RightChild = CreateLeafNode(Screen, Parent, RightWindowID, ContainerLower);
+            Parent->LeftChild = CreateLeafNode(Context, Space, Parent, LeftWindowID, ContainerUpper);
+            Parent->RightChild = CreateLeafNode(Context, Space, Parent, RightWindowID, ContainerLower);
         } break;
         default:
         {
@@ -72,6 +156,43 @@ void CreateLeafNodePair(screen_info *Screen, tree_node *Parent, int FirstWindowI
             Parent = NULL;
         } break;
     }
+
+    if(Parent)
+    {
+        tree_node *Left = Parent->LeftChild;
+        tree_node *Right = Parent->RightChild;
+
+        Left->PrevLeaf = Parent->PrevLeaf;
+        Left->NextLeaf = Right;
+        Right->PrevLeaf = Left;
+        Right->NextLeaf = Parent->NextLeaf;
+
+        if(Left->PrevLeaf)
+            Left->PrevLeaf->NextLeaf = Left;
+
+        if(Right->NextLeaf)
+            Right->NextLeaf->PrevLeaf = Right;
+
+        UpdateLeafCount(Parent, 1);
+
+        Parent->PrevLeaf = NULL;
+        Parent->NextLeaf = NULL;
+    }
+}
+
+void UnlinkLeafNode(tree_node *Node)
+{
+    if(Node)
+    {
+        if(Node->PrevLeaf)
+            Node->PrevLeaf->NextLeaf = Node->NextLeaf;
+
+        if(Node->NextLeaf)
+            Node->NextLeaf->PrevLeaf = Node->PrevLeaf;
+
+        Node->PrevLeaf = NULL;
+        Node->NextLeaf = NULL;
+    }
 }
 
 bool IsLeafNode(tree_node *Node)
@@ -109,31 +230,149 @@ bool IsRightLeaf(tree_node *Node)
     return IsRightChild(Node) && IsLeafNode(Node);
 }
 
-void SwapNodeWindowIDs(tree_node *A, tree_node *B)
+void SwapNodeWindowIDs(space_info *Space, tree_node *A, tree_node *B)
 {
     if(A && B)
     {
         DEBUG("SwapNodeWindowIDs() " << A->WindowID << " with " << B->WindowID)
+
         int TempWindowID = A->WindowID;
         A->WindowID = B->WindowID;
         B->WindowID = TempWindowID;
-        ResizeWindowToContainerSize(A);
-        ResizeWindowToContainerSize(B);
+
+        if(A->WindowID != -1)
+            Space->WindowNodes[A->WindowID] = A;
+
+        if(B->WindowID != -1)
+            Space->WindowNodes[B->WindowID] = B;
+
+        // Neighbours point at nodes, only a swap with an empty leaf changes them
+        if(A->WindowID == -1 || B->WindowID == -1)
+            ++Space->NeighbourGeneration;
+
+        if(Space->Mode == SpaceModeBSP)
+        {
+            MarkNodeDirty(A);
+            MarkNodeDirty(B);
+        }
+        else
+        {
+            A->Dirty = false;
+            B->Dirty = false;
+            ResizeWindowToContainerSize(A);
+            ResizeWindowToContainerSize(B);
+        }
     }
 }
 
-// Note - in Monocle Mode, every Node is a "Root" (i.e. no parent),so
-// every node is resized to the RootNodeContainer.
-// TODO -- Does this need an "OptimalSplitMode" boolean argument?
-void ResizeNodeContainer(screen_info *Screen, tree_node *Node)
+// Note - in Monocle Mode, every Node is an unlinked "Root" kept in the
+// window_ring of the space, so every node is resized to the RootNodeContainer.
+void ResizeNodeContainer(const layout_context &Context, tree_node *Node)
 {
     Assert(Node, "ResizeNodeContainer()")
 
+    split_mode SplitMode = Node->Container.SplitMode;
+    double SplitRatio = Node->Container.SplitRatio;
+
     // BSP Root Node or Monocle Node
-    if (Node && !Node->Parent)
-        SetRootNodeContainer(Screen, &Node->Container);
+    if (!Node->Parent)
+    {
+        SetRootNodeContainer(Context, &Node->Container);
+    }
     else
-        ResizeContainer(Screen, &Node->Container);
+    {
+        bool Vertical = Node->Parent->Container.SplitMode == SplitModeVertical;
+        container_type ContainerType;
+        if(IsLeftChild(Node))
+            ContainerType = Vertical ? ContainerLeft : ContainerUpper;
+        else
+            ContainerType = Vertical ? ContainerRight : ContainerLower;
+
+        node_container ParentContainer = Node->Parent->Container;
+        ParentContainer.SplitRatio = GetConstrainedSplitRatio(Context, Node->Parent);
+        Node->Container = CreateNodeContainer(Context, ParentContainer, ContainerType);
+    }
+
+    // The split of a parent belongs to the node, only its geometry follows the screen
+    if(!IsLeafNode(Node) || !Node->Parent)
+    {
+        Node->Container.SplitMode = SplitMode;
+        Node->Container.SplitRatio = SplitRatio;
+    }
+}
+
+void UpdateNodeMinimumSize(const layout_context &Context, tree_node *Node)
+{
+    if(IsLeafNode(Node))
+    {
+        Node->MinWidth = 0;
+        Node->MinHeight = 0;
+
+        std::unordered_map<int, window_constraint>::const_iterator It = Context.Constraints->find(Node->WindowID);
+        if(It != Context.Constraints->end())
+        {
+            Node->MinWidth = It->second.MinWidth;
+            Node->MinHeight = It->second.MinHeight;
+        }
+
+        return;
+    }
+
+    tree_node *Left = Node->LeftChild;
+    tree_node *Right = Node->RightChild;
+    if(Node->Container.SplitMode == SplitModeVertical)
+    {
+        Node->MinWidth = Left->MinWidth + Right->MinWidth + GetPixelEdge(Context.Offset.VerticalGap);
+        Node->MinHeight = std::max(Left->MinHeight, Right->MinHeight);
+    }
+    else
+    {
+        Node->MinWidth = std::max(Left->MinWidth, Right->MinWidth);
+        Node->MinHeight = Left->MinHeight + Right->MinHeight + GetPixelEdge(Context.Offset.HorizontalGap);
+    }
+}
+
+double GetConstrainedSplitRatio(const layout_context &Context, tree_node *Node)
+{
+    double SplitRatio = Node->Container.SplitRatio;
+    if(Context.Constraints->empty() || !Node->LeftChild || !Node->RightChild)
+        return SplitRatio;
+
+    tree_node *Left = Node->LeftChild;
+    tree_node *Right = Node->RightChild;
+    bool Vertical = Node->Container.SplitMode == SplitModeVertical;
+    double Length = Vertical ? Node->Container.Width : Node->Container.Height;
+    int Gap = GetPixelEdge(Vertical ? Context.Offset.VerticalGap : Context.Offset.HorizontalGap);
+    double LeftMin = (Vertical ? Left->MinWidth : Left->MinHeight) + Gap / 2;
+    double RightMin = (Vertical ? Right->MinWidth : Right->MinHeight) + (Gap - Gap / 2);
+
+    // Both sides can not fit, keep the ratio chosen by the user
+    if(Length <= 0 || LeftMin + RightMin > Length)
+        return SplitRatio;
+
+    double Split = GetContainerSplitOffset(Length, SplitRatio);
+    if(Split < LeftMin)
+        Split = LeftMin;
+    else if(Split > Length - RightMin)
+        Split = Length - RightMin;
+
+    return Split / Length;
+}
+
+void UpdateLeafCount(tree_node *Node, int Delta)
+{
+    for(; Node; Node = Node->Parent)
+        Node->LeafCount += Delta;
+}
+
+void MarkNodeDirty(tree_node *Node)
+{
+    if(Node)
+    {
+        Node->Dirty = true;
+        for(tree_node *Parent = Node->Parent; Parent && !Parent->DirtyChild; Parent = Parent->Parent)
+            Parent->DirtyChild = true;
+    }
 }
 
 bool ModifyNodeSplitRatio(tree_node *Node, const double &Offset)
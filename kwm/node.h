@@ -5,24 +5,57 @@
 
 #include "types.h"
 
+/* Hand out a zeroed tree_node from the node_pool of a space.
+   Nodes are taken from the free-list first, then bump-allocated from the
+   current chunk. A new chunk is only allocated when every chunk is in use.
+    Input:
+        Pool - node_pool owned by the space_info the node belongs to
+    Output:
+        tree_node* - zeroed node, valid until freed or the pool is reset
+*/
+tree_node *AllocateNode(node_pool *Pool);
+
+/* Return a single tree_node to the free-list of its node_pool */
+void FreeNode(node_pool *Pool, tree_node *Node);
+
+/* Release every tree_node of the pool at once, keeping the chunks for reuse */
+void ResetNodePool(node_pool *Pool);
+
+/* Free the chunks owned by the pool; used when the space itself goes away */
+void DestroyNodePool(node_pool *Pool);
+
+/* Assign a WindowID to a node and keep Space->WindowNodes in sync.
+   Only nodes that own their window (leaves) should be assigned through
+   this function; the index always resolves a window to its own leaf.
+    Input:
+        Space - owner of the WindowID -> tree_node index
+        Node - node to assign
+        WindowID - new window, or -1 to clear the node
+    Output:
+        tree_node *Node - mutate WindowID
+*/
+void SetNodeWindowID(space_info *Space, tree_node *Node, int WindowID);
+
 /* Create new tree_node from Parent
     Map:
         <args> -> tree_node
     Input:
-        Screen - for creating container
+        Context - for creating container
+        Space - owner of the node_pool and WindowID index
         Parent - for tree_node::Parent
         WindowID - for tree_node::WindowID
         ContainerType - for creating container
     Output:
         tree_node (new)
 */
-tree_node *CreateLeafNode(screen_info *Screen, tree_node *Parent, int WindowID, const container_type &ContainerType);
+tree_node *CreateLeafNode(const layout_context &Context, space_info *Space, tree_node *Parent, int WindowID, const container_type &ContainerType);
 
 /* Create new children tree_nodes from Parent
     Map:
         <args> -> Parent->LeftChild, Parent->RightChild
     Input:
-        Screen - pass to CreateLeafNode()
+        Context - pass to CreateLeafNode()
+        Space - pass to CreateLeafNode()
         Parent - Node for which to create children
         FirstWindowID - WindowID of first child
         SecondWindowID - WindowID of second child
@@ -31,21 +64,60 @@ tree_node *CreateLeafNode(screen_info *Screen, tree_node *Parent, int WindowID,
         node_info *Parent - mutate to delete its WindowID, 
                             update its Container, 
                             and create two children leaf nodes
+                            that take its place in the leaf list
  */
-void CreateLeafNodePair(screen_info *Screen, tree_node *Parent, int FirstWindowID, int SecondWindowID, const split_mode &SplitMode);
+void CreateLeafNodePair(const layout_context &Context, space_info *Space, tree_node *Parent, int FirstWindowID, int SecondWindowID, const split_mode &SplitMode);
+
+/* Remove a BSP leaf from the PrevLeaf/NextLeaf list, joining its neighbours */
+void UnlinkLeafNode(tree_node *Node);
 
 /* Create an empty RootNode for the tree
     Map:
         <none> -> tree_node
     Input:
-        <none>
+        Context - for creating the root container
+        Space - owner of the node_pool
     Output:
         tree_node* - populate elements with invalid/null/uninitialized data.
 */
-tree_node *CreateRootNode(screen_info *Screen);
+tree_node *CreateRootNode(const layout_context &Context, space_info *Space);
 
-/* Mutate Node->Container based on Screen state */
-void ResizeNodeContainer(screen_info *Screen, tree_node *Node);
+/* Mutate Node->Container based on the layout_context and the container of Node->Parent.
+   SplitMode and SplitRatio of a parent node are kept. */
+void ResizeNodeContainer(const layout_context &Context, tree_node *Node);
+
+/* Split-ratio of Node moved just enough that both children can hold the
+   minimum size learned for their windows. The stored SplitRatio is left as is.
+   The minimum sizes are read from MinWidth/MinHeight of the children, which
+   UpdateTreeMinimumSizes() fills in bottom-up before every layout pass.
+    Input:
+        Context - learned window constraints and gaps
+        Node - parent node whose split is used
+    Output:
+        UpdateNodeMinimumSize() - smallest container the subtree of Node fits in,
+                                  from the minimum sizes of its children
+        GetConstrainedSplitRatio() - split-ratio to lay out the children with
+*/
+void UpdateNodeMinimumSize(const layout_context &Context, tree_node *Node);
+double GetConstrainedSplitRatio(const layout_context &Context, tree_node *Node);
+
+/* Flag Node for layout recomputation and its ancestors as leading to it
+    Input:
+        Node - node whose split, geometry or window changed
+    Output:
+        tree_node *Node - set Dirty, set DirtyChild on every ancestor
+*/
+void MarkNodeDirty(tree_node *Node);
+
+/* Every node keeps the number of leaves in its subtree in LeafCount.
+   Adding or removing a leaf only touches the path to the root.
+    Input:
+        Node - lowest node whose subtree gained or lost leaves
+        Delta - number of leaves added, negative when removed
+    Output:
+        tree_node *Node - mutate LeafCount of Node and every ancestor
+*/
+void UpdateLeafCount(tree_node *Node, int Delta);
 
 /* Node properties */
 bool IsLeafNode(tree_node *Node);
@@ -55,16 +127,17 @@ bool IsLeftLeaf(tree_node *Node);
 bool IsRightLeaf(tree_node *Node);
 bool IsRootNode(tree_node *Node);
 
-// TODO -- This calls the recursive function ApplyNodeContainer
 /* Swap the WindowIDs in two nodes and resize them to their new node_container.
+   BSP nodes are marked dirty and resized by the next FlushTreeLayout().
     Input:
+        Space - owner of the WindowID -> tree_node index
         A - first node to swap.
         B - second node to swap.
     Output:
         A - mutate WindowID and A->Container
         B - mutate WindowID and A->Container
 */
-void SwapNodeWindowIDs(tree_node *A, tree_node *B);
+void SwapNodeWindowIDs(space_info *Space, tree_node *A, tree_node *B);
 
 bool ModifyNodeSplitRatio(tree_node *Node, const double &Offset);
 void ToggleNodeSplitMode(tree_node *Node);
@@ -10,108 +10,122 @@
 extern kwm_screen KWMScreen;
 extern kwm_path KWMPath;
 
-void CreateDeserializedNodeContainer(tree_node *Node)
+void CreateDeserializedNodeContainer(const layout_context &Context, tree_node *Node)
 {
     split_mode SplitMode = Node->Parent->Container.SplitMode;
-    container_type ContainerType;
-
-    switch(SplitMode)
+    if(SplitMode != SplitModeVertical && SplitMode != SplitModeHorizontal)
     {
-        case SplitModeHorizontal:
-        {
-            ContainerType = IsLeftLeaf(Node) ? ContainerLeft : ContainerRight;
-        } break;
-        case SplitModeVertical:
-        {
-            ContainerType = IsLeftLeaf(Node) ? ContainerUpper : ContainerLower;
-        } break;
-        default:
-        {
-            DEBUG("CreateDeserializedNodeContainer() Invalid SplitMode given: " << SplitMode)
-        } break;
+        DEBUG("CreateDeserializedNodeContainer() Invalid SplitMode given: " << SplitMode)
     }
 
-    Node->Container = CreateNodeContainer(KWMScreen.Current, Node->Parent->Container, ContainerType);
+    ResizeNodeContainer(Context, Node);
 }
 
 void FillDeserializedTree(tree_node *RootNode)
 {
     std::vector<window_info*> Windows = GetAllWindowsOnDisplay(KWMScreen.Current->ID);
+    space_info *Space = GetActiveSpaceOfScreen(KWMScreen.Current);
+    layout_context Context = CreateLayoutContext(KWMScreen.Current, Space);
     tree_node *Current = GetFirstLeafNode(RootNode);
 
     std::size_t Counter = 0, Leafs = 0;
     while(Current)
     {
         if(Counter < Windows.size())
-            Current->WindowID = Windows[Counter++]->WID;
+            SetNodeWindowID(Space, Current, Windows[Counter++]->WID);
 
         Current = GetNearestNodeToTheRight(Current, SpaceModeBSP);
         ++Leafs;
     }
 
-    if(Leafs < Windows.size() && Counter < Windows.size())
+    if(Leafs < Windows.size())
     {
-        tree_node *Root = RootNode;
-        for(; Counter < Windows.size(); ++Counter)
+        DEBUG("FillDeserializedTree() Distribute " << Windows.size() - Leafs << " windows over " << Leafs << " leafs")
+        std::size_t Extra = Windows.size() - Leafs;
+        std::size_t LeafIndex = 0;
+        Current = GetFirstLeafNode(RootNode);
+        while(Current)
         {
-            while(!IsLeafNode(Root))
+            tree_node *Next = GetNearestNodeToTheRight(Current, SpaceModeBSP);
+            std::size_t Count = Extra / Leafs + (LeafIndex < Extra % Leafs ? 1 : 0);
+            if(Count > 0)
             {
-                if(!IsLeafNode(Root->LeftChild) && IsLeafNode(Root->RightChild))
-                    Root = Root->RightChild;
-                else
-                    Root = Root->LeftChild;
+                std::vector<window_info*> LeafWindows(1, Windows[LeafIndex]);
+                LeafWindows.insert(LeafWindows.end(), Windows.begin() + Counter, Windows.begin() + Counter + Count);
+                CreateBalancedBSPTree(Context, Space, Current, LeafWindows, 0, LeafWindows.size());
+                Counter += Count;
             }
 
-            DEBUG("FillDeserializedTree() Create pair of leafs")
-            CreateLeafNodePair(KWMScreen.Current, Root, Root->WindowID, Windows[Counter]->WID, GetOptimalSplitMode(Root->Container));
-            Root = RootNode;
+            Current = Next;
+            ++LeafIndex;
         }
     }
+
+    AssignWindowsToLeafNodes(Space, RootNode, Windows);
 }
 
 void SerializeParentNode(tree_node *Parent, std::string Role, std::vector<std::string> &Serialized)
 {
-    Serialized.push_back("kwmc tree root create " + Role);
-    Serialized.push_back("kwmc tree split-mode " + std::to_string(Parent->Container.SplitMode));
-    Serialized.push_back("kwmc tree split-ratio " + std::to_string(Parent->Container.SplitRatio));
-
-    if(IsLeafNode(Parent->LeftChild))
+    tree_traversal Traversal;
+    BeginTreeTraversal(&Traversal, Parent, SpaceModeBSP, TraversalPreOrder);
+    while(tree_node *Node = NextTreeNode(&Traversal))
     {
-        Serialized.push_back("kwmc tree child");
-        Serialized.push_back("kwmc tree leaf create left");
-    }
-    else
-    {
-        Serialized.push_back("kwmc tree child");
-        SerializeParentNode(Parent->LeftChild, "left", Serialized);
-    }
+        std::string NodeRole = Role;
+        if(Node != Parent)
+        {
+            NodeRole = IsLeftChild(Node) ? "left" : "right";
+            Serialized.push_back("kwmc tree child");
+        }
 
-    if(IsLeafNode(Parent->RightChild))
-    {
-        Serialized.push_back("kwmc tree child");
-        Serialized.push_back("kwmc tree leaf create right");
+        if(IsLeafNode(Node))
+        {
+            Serialized.push_back("kwmc tree leaf create " + NodeRole);
+        }
+        else
+        {
+            Serialized.push_back("kwmc tree root create " + NodeRole);
+            Serialized.push_back("kwmc tree split-mode " + std::to_string(Node->Container.SplitMode));
+            Serialized.push_back("kwmc tree split-ratio " + std::to_string(Node->Container.SplitRatio));
+        }
     }
+}
+
+tree_node *CreateDeserializedChildNode(const layout_context &Context, space_info *Space, tree_node *Parent, bool Left)
+{
+    tree_node *Node = CreateLeafNode(Context, Space, Parent, -1, Left ? ContainerLeft : ContainerRight);
+    if(Left)
+        Parent->LeftChild = Node;
     else
-    {
-        Serialized.push_back("kwmc tree child");
-        SerializeParentNode(Parent->RightChild, "right", Serialized);
-    }
+        Parent->RightChild = Node;
+
+    CreateDeserializedNodeContainer(Context, Node);
+    return Node;
 }
 
-unsigned int DeserializeParentNode(tree_node *Parent, std::vector<std::string> &Serialized, unsigned int Index)
+tree_node *DeserializeNodeTree(std::vector<std::string> &Serialized)
 {
-    unsigned int LineNumber = Index;
-    for(;LineNumber < Serialized.size(); ++LineNumber)
+    if(Serialized.empty() || Serialized[0] != "kwmc tree root create parent")
+        return NULL;
+
+    DEBUG("Deserialize: Create Master")
+    space_info *Space = GetActiveSpaceOfScreen(KWMScreen.Current);
+    layout_context Context = CreateLayoutContext(KWMScreen.Current, Space);
+    tree_node *RootNode = CreateRootNode(Context, Space);
+    tree_node *Parent = RootNode;
+
+    for(std::size_t LineNumber = 1; Parent && LineNumber < Serialized.size(); ++LineNumber)
     {
         std::string Line = Serialized[LineNumber];
         std::vector<std::string> Tokens = SplitString(Line, ' ');
+        if(Tokens.size() < 3)
+            continue;
 
-        if(Tokens[2] == "split-mode")
+        if(Tokens[2] == "split-mode" && Tokens.size() > 3)
         {
             Parent->Container.SplitMode = static_cast<split_mode>(ConvertStringToInt(Tokens[3]));
             DEBUG("Root: SplitMode Found " + Tokens[3])
         }
-        else if(Tokens[2] == "split-ratio")
+        else if(Tokens[2] == "split-ratio" && Tokens.size() > 3)
         {
             Parent->Container.SplitRatio = ConvertStringToDouble(Tokens[3]);
             DEBUG("Root: SplitRatio Found " + Tokens[3])
@@ -120,65 +134,25 @@ unsigned int DeserializeParentNode(tree_node *Parent, std::vector<std::string> &
         {
             DEBUG("Root: Child Found")
             DEBUG("Parent: " << Parent->Container.SplitMode << "|" << Parent->Container.SplitRatio)
-            LineNumber = DeserializeChildNode(Parent, Serialized, LineNumber+1);
-        }
-
-        if(Parent->RightChild)
-            return LineNumber;
-    }
-
-    return LineNumber;
-}
-
-unsigned int DeserializeChildNode(tree_node *Parent, std::vector<std::string> &Serialized, unsigned int Index)
-{
-    unsigned int LineNumber = Index;
-    for(;LineNumber < Serialized.size(); ++LineNumber)
-    {
-        std::string Line = Serialized[LineNumber];
-        if(Line == "kwmc tree root create left")
-        {
-            DEBUG("Child: Create root")
-            Parent->LeftChild = CreateLeafNode(KWMScreen.Current, Parent, -1, ContainerLeft);
-            CreateDeserializedNodeContainer(Parent->LeftChild);
-            LineNumber = DeserializeParentNode(Parent->LeftChild, Serialized, LineNumber+1);
-            return LineNumber;
         }
-        else if(Line == "kwmc tree root create right")
+        else if(Line == "kwmc tree root create left" || Line == "kwmc tree root create right")
         {
             DEBUG("Child: Create root")
-            Parent->RightChild = CreateLeafNode(KWMScreen.Current, Parent, -1, ContainerRight);
-            CreateDeserializedNodeContainer(Parent->RightChild);
-            LineNumber = DeserializeParentNode(Parent->RightChild, Serialized, LineNumber+1);
-            return LineNumber;
-        }
-        else if(Line == "kwmc tree leaf create left")
-        {
-            DEBUG("Child: Create left leaf")
-            Parent->LeftChild = CreateLeafNode(KWMScreen.Current, Parent, -1, ContainerLeft);
-            CreateDeserializedNodeContainer(Parent->LeftChild);
-            return LineNumber;
+            Parent = CreateDeserializedChildNode(Context, Space, Parent, Line == "kwmc tree root create left");
         }
-        else if(Line == "kwmc tree leaf create right")
+        else if(Line == "kwmc tree leaf create left" || Line == "kwmc tree leaf create right")
         {
-            DEBUG("Child: Create right leaf")
-            Parent->RightChild = CreateLeafNode(KWMScreen.Current, Parent, -1, ContainerRight);
-            CreateDeserializedNodeContainer(Parent->RightChild);
-            return LineNumber;
+            DEBUG("Child: Create leaf")
+            CreateDeserializedChildNode(Context, Space, Parent, Line == "kwmc tree leaf create left");
+
+            // A parent is complete once its right child is; climb past every completed parent
+            while(Parent && Parent->RightChild)
+                Parent = Parent->Parent;
         }
     }
 
-    return LineNumber;
-}
-
-tree_node *DeserializeNodeTree(std::vector<std::string> &Serialized)
-{
-    if(Serialized.empty() || Serialized[0] != "kwmc tree root create parent")
-        return NULL;
-
-    DEBUG("Deserialize: Create Master")
-    tree_node *RootNode = CreateRootNode(KWMScreen.Current);
-    DeserializeParentNode(RootNode, Serialized, 1);
+    CountLeafNodes(RootNode);
+    LinkLeafNodes(RootNode, NULL, NULL);
     return RootNode;
 }
 
@@ -228,10 +202,13 @@ void LoadBSPTreeFromFile(screen_info *Screen, std::string Name)
         while(std::getline(InFD, Line))
             SerializedTree.push_back(Line);
 
-        DestroyNodeTree(Space->RootNode, SpaceModeBSP);
+        DestroyNodeTree(Space);
         Space->RootNode = DeserializeNodeTree(SerializedTree);
         FillDeserializedTree(Space->RootNode);
-        ApplyNodeContainer(Space->RootNode, SpaceModeBSP);
+
+        // One constrained pass over the restored tree, before the borders follow the windows
+        MarkNodeDirty(Space->RootNode);
+        FlushTreeLayout(Screen);
         UpdateBorder("focused");
         UpdateBorder("marked");
     }
@@ -7,10 +7,9 @@
 void SaveBSPTreeToFile(screen_info *Screen, std::string Name);
 void LoadBSPTreeFromFile(screen_info *Screen, std::string Name);
 void SerializeParentNode(tree_node *Parent, std::string Role, std::vector<std::string> &Serialized);
-unsigned int DeserializeParentNode(tree_node *Parent, std::vector<std::string> &Serialized, unsigned int Index);
-unsigned int DeserializeChildNode(tree_node *Parent, std::vector<std::string> &Serialized, unsigned int Index);
+tree_node *CreateDeserializedChildNode(const layout_context &Context, space_info *Space, tree_node *Parent, bool Left);
 tree_node *DeserializeNodeTree(std::vector<std::string> &Serialized);
-void CreateDeserializedNodeContainer(tree_node *Node);
+void CreateDeserializedNodeContainer(const layout_context &Context, tree_node *Node);
 void FillDeserializedTree(tree_node *RootNode);
 
 #endif
@@ -14,38 +14,11 @@ extern kwm_border MarkedBorder;
 
 void GetTagForMonocleSpace(space_info *Space, std::string &Tag)
 {
-    tree_node *Node = Space->RootNode;
-    bool FoundFocusedWindow = false;
-    int FocusedIndex = 0;
-    int NumberOfWindows = 0;
+    int NumberOfWindows = GetRingNodeCount(&Space->Ring);
+    tree_node *FocusedNode = KWMFocus.Window ? GetNodeFromWindowID(Space, KWMFocus.Window->WID) : NULL;
 
-    if(Node && KWMFocus.Window)
-    {
-        FocusedIndex = 1;
-        NumberOfWindows = 1;
-
-        if(Node->WindowID == KWMFocus.Window->WID)
-            FoundFocusedWindow = true;
-
-        while(Node->RightChild)
-        {
-            if(Node->WindowID == KWMFocus.Window->WID)
-                FoundFocusedWindow = true;
-
-            if(!FoundFocusedWindow)
-                ++FocusedIndex;
-
-            ++NumberOfWindows;
-
-            Node = Node->RightChild;
-        }
-
-        if(Node->WindowID == KWMFocus.Window->WID)
-            FoundFocusedWindow = true;
-    }
-
-    if(FoundFocusedWindow)
-        Tag = "[" + std::to_string(FocusedIndex) + "/" + std::to_string(NumberOfWindows) + "]";
+    if(FocusedNode)
+        Tag = "[" + std::to_string(GetRingNodePosition(&Space->Ring, FocusedNode) + 1) + "/" + std::to_string(NumberOfWindows) + "]";
     else
         Tag = "[" + std::to_string(NumberOfWindows) + "]";
 }
@@ -61,6 +34,10 @@ void GetTagForCurrentSpace(std::string &Tag)
             Tag = "[float]";
         else if(Space->Mode == SpaceModeMonocle)
             GetTagForMonocleSpace(Space, Tag);
+        else if(Space->Mode == SpaceModeMaster)
+            Tag = "[master]";
+        else if(Space->Mode == SpaceModeGrid)
+            Tag = "[grid]";
     }
     else
     {
@@ -70,9 +47,20 @@ void GetTagForCurrentSpace(std::string &Tag)
             Tag = "[float]";
         else if(KWMMode.Space == SpaceModeMonocle)
             Tag = "[monocle]";
+        else if(KWMMode.Space == SpaceModeMaster)
+            Tag = "[master]";
+        else if(KWMMode.Space == SpaceModeGrid)
+            Tag = "[grid]";
     }
 }
 
+bool IsRingSpaceMode(space_tiling_option Mode)
+{
+    return Mode == SpaceModeMonocle ||
+           Mode == SpaceModeMaster ||
+           Mode == SpaceModeGrid;
+}
+
 bool IsActiveSpaceFloating()
 {
     return IsSpaceFloating(KWMScreen.Current->ActiveSpace);
@@ -86,7 +74,7 @@ bool IsSpaceFloating(int SpaceID)
     {
         std::map<int, space_info>::iterator It = KWMScreen.Current->Space.find(SpaceID);
         if(It != KWMScreen.Current->Space.end())
-            Result = KWMScreen.Current->Space[SpaceID].Mode == SpaceModeFloating;
+            Result = It->second.Mode == SpaceModeFloating;
     }
 
     return Result;
@@ -178,8 +166,7 @@ void FloatFocusedSpace()
         if(Space->Mode == SpaceModeFloating)
             return;
 
-        DestroyNodeTree(Space->RootNode, Space->Mode);
-        Space->RootNode = NULL;
+        DestroyNodeTree(Space);
 
         Space->Mode = SpaceModeFloating;
         Space->Initialized = true;
@@ -198,8 +185,7 @@ void TileFocusedSpace(space_tiling_option Mode)
         if(Space->Mode == Mode)
             return;
 
-        DestroyNodeTree(Space->RootNode, Space->Mode);
-        Space->RootNode = NULL;
+        DestroyNodeTree(Space);
 
         Space->Mode = Mode;
         std::vector<window_info*> WindowsOnDisplay = GetAllWindowsOnDisplay(KWMScreen.Current->ID);
@@ -231,6 +217,7 @@ void UpdateActiveSpace()
 
         KWMScreen.ForceRefreshFocus = true;
         UpdateActiveWindowList(KWMScreen.Current);
+        FlushTreeLayout(KWMScreen.Current);
 
         space_info *Space = GetActiveSpaceOfScreen(KWMScreen.Current);
         if(Space->FocusedNode)
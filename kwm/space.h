@@ -18,6 +18,10 @@ bool IsSpaceTransitionInProgress();
 bool IsSpaceFloating(int SpaceID);
 bool IsActiveSpaceFloating();
 
+/* Monocle, master-stack and grid spaces keep their windows as unlinked
+   root nodes in the window_ring of the space instead of a BSP-tree */
+bool IsRingSpaceMode(space_tiling_option Mode);
+
 void TileFocusedSpace(space_tiling_option Mode);
 void FloatFocusedSpace();
 void ToggleFocusedSpaceFloating();
@@ -2,6 +2,14 @@
 #include "node.h"
 #include "space.h" // for GetActiveSpaceOfScreen()
 #include "window.h" // remove ResizeWindowToContainerSize
+#include "container.h" // for GetOptimalSplitMode()
+#include "border.h" // for UpdateBorder()
+#include "geometry.h" // for GetDirectedRectDistances()
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
 
 extern kwm_path KWMPath;
 extern kwm_screen KWMScreen;
@@ -12,62 +20,230 @@ tree_node *CreateTreeFromWindowIDList(screen_info *Screen, const std::vector<win
     if(IsSpaceFloating(Screen->ActiveSpace))
         return NULL;
 
-    tree_node *RootNode = CreateRootNode(Screen);
-
     bool Result = false;
     space_info *Space = GetActiveSpaceOfScreen(Screen);
+    layout_context Context = CreateLayoutContext(Screen, Space);
+    tree_node *RootNode = CreateRootNode(Context, Space);
 
     if(Space->Mode == SpaceModeBSP)
-        Result = CreateBSPTree(RootNode, Screen, Windows);
-    else if(Space->Mode == SpaceModeMonocle)
-        Result = CreateMonocleTree(RootNode, Screen, Windows);
+        Result = CreateBSPTree(Context, Space, RootNode, Windows);
+    else if(IsRingSpaceMode(Space->Mode))
+        Result = CreateMonocleTree(Context, Space, RootNode, Windows);
 
     if(!Result)
     {
-        free(RootNode);
+        FreeNode(&Space->Pool, RootNode);
         RootNode = NULL;
     }
 
     return RootNode;
 }
 
-bool CreateBSPTree(tree_node *RootNode, screen_info *Screen, const std::vector<window_info*> &Windows)
+bool CreateBSPTree(const layout_context &Context, space_info *Space, tree_node *RootNode, const std::vector<window_info*> &Windows)
 {
     Assert(RootNode, "CreateBSPTree()")
 
     bool Result = false;
 
-    if(Windows.size() >= 2)
+    if(!Windows.empty())
     {
-        tree_node *Root = RootNode;
-        Root->WindowID = Windows[0]->WID;
-        for(std::size_t WindowIndex = 1; WindowIndex < Windows.size(); ++WindowIndex)
+        DEBUG("CreateBSPTree() Build balanced tree of " << Windows.size() << " windows")
+        CreateBalancedBSPTree(Context, Space, RootNode, Windows, 0, Windows.size());
+        AssignWindowsToLeafNodes(Space, RootNode, Windows);
+        Result = true;
+    }
+
+    return Result;
+}
+
+void CreateBalancedBSPTree(const layout_context &Context, space_info *Space, tree_node *Leaf, const std::vector<window_info*> &Windows, std::size_t First, std::size_t Count)
+{
+    Assert(Leaf && IsLeafNode(Leaf), "CreateBalancedBSPTree()")
+
+    tree_node *Before = Leaf->PrevLeaf;
+    tree_node *After = Leaf->NextLeaf;
+
+    SetNodeWindowID(Space, Leaf, -1);
+    CreateBalancedBSPSubtree(Context, Space, Leaf, Windows, First, Count);
+    LinkLeafNodes(Leaf, Before, After);
+    UpdateLeafCount(Leaf->Parent, Count - 1);
+}
+
+void CreateBalancedBSPSubtree(const layout_context &Context, space_info *Space, tree_node *Node, const std::vector<window_info*> &Windows, std::size_t First, std::size_t Count)
+{
+    Node->LeafCount = Count;
+    if(Count == 1)
+    {
+        SetNodeWindowID(Space, Node, Windows[First]->WID);
+        return;
+    }
+
+    Node->Container.SplitMode = GetOptimalSplitMode(Node->Container);
+    Node->Container.SplitRatio = Context.SplitRatio;
+
+    bool Vertical = Node->Container.SplitMode == SplitModeVertical;
+    Node->LeftChild = CreateLeafNode(Context, Space, Node, -1, Vertical ? ContainerLeft : ContainerUpper);
+    Node->RightChild = CreateLeafNode(Context, Space, Node, -1, Vertical ? ContainerRight : ContainerLower);
+
+    std::size_t LeftCount = (Count + 1) / 2;
+    CreateBalancedBSPSubtree(Context, Space, Node->LeftChild, Windows, First, LeftCount);
+    CreateBalancedBSPSubtree(Context, Space, Node->RightChild, Windows, First + LeftCount, Count - LeftCount);
+}
+
+leaf_assignment GetLeafAssignment(tree_node *Leaf, std::size_t LeafIndex, const window_info *Window, std::size_t WindowIndex)
+{
+    const node_container &Container = Leaf->Container;
+    double Width = std::min(Container.X + Container.Width, (double)Window->X + Window->Width) - std::max(Container.X, (double)Window->X);
+    double Height = std::min(Container.Y + Container.Height, (double)Window->Y + Window->Height) - std::max(Container.Y, (double)Window->Y);
+    double DX = (Container.X + Container.Width / 2) - (Window->X + Window->Width / 2.0);
+    double DY = (Container.Y + Container.Height / 2) - (Window->Y + Window->Height / 2.0);
+
+    leaf_assignment Pair;
+    Pair.Leaf = LeafIndex;
+    Pair.Window = WindowIndex;
+    Pair.Overlap = (Width > 0 && Height > 0) ? Width * Height : 0;
+    Pair.Distance = DX * DX + DY * DY;
+    return Pair;
+}
+
+void AssignWindowsToLeafNodes(space_info *Space, tree_node *Root, const std::vector<window_info*> &Windows)
+{
+    std::unordered_map<int, window_info*> WindowLookup;
+    for(std::size_t WindowIndex = 0; WindowIndex < Windows.size(); ++WindowIndex)
+        WindowLookup[Windows[WindowIndex]->WID] = Windows[WindowIndex];
+
+    std::vector<tree_node*> Leaves;
+    std::vector<window_info*> Placed;
+    tree_traversal Traversal;
+    BeginTreeTraversal(&Traversal, Root, SpaceModeBSP, TraversalLeafOrder);
+    while(tree_node *Node = NextTreeNode(&Traversal))
+    {
+        Leaves.push_back(Node);
+        std::unordered_map<int, window_info*>::iterator It = WindowLookup.find(Node->WindowID);
+        if(Node->WindowID != -1 && It != WindowLookup.end())
+            Placed.push_back(It->second);
+    }
+
+    if(Leaves.size() < 2 || Placed.empty())
+        return;
+
+    // Bucket the leaf centers in a grid over the root container, roughly one leaf per cell
+    const node_container &Bounds = Root->Container;
+    int Columns = std::max(1, (int)std::ceil(std::sqrt((double)Leaves.size())));
+    int Rows = Columns;
+    double CellWidth = std::max(1.0, Bounds.Width / Columns);
+    double CellHeight = std::max(1.0, Bounds.Height / Rows);
+    std::vector<std::vector<std::size_t> > Cells(Columns * Rows);
+    for(std::size_t LeafIndex = 0; LeafIndex < Leaves.size(); ++LeafIndex)
+    {
+        const node_container &Container = Leaves[LeafIndex]->Container;
+        int Column = std::min(Columns - 1, std::max(0, (int)((Container.X + Container.Width / 2 - Bounds.X) / CellWidth)));
+        int Row = std::min(Rows - 1, std::max(0, (int)((Container.Y + Container.Height / 2 - Bounds.Y) / CellHeight)));
+        Cells[Row * Columns + Column].push_back(LeafIndex);
+    }
+
+    // Only the leaves in the cells around a window are scored, best first:
+    // largest overlap, then nearest center
+    std::vector<leaf_assignment> Pairs;
+    std::vector<leaf_assignment> Candidates;
+    Pairs.reserve(Placed.size() * LEAF_ASSIGNMENT_CANDIDATES);
+    for(std::size_t WindowIndex = 0; WindowIndex < Placed.size(); ++WindowIndex)
+    {
+        const window_info *Window = Placed[WindowIndex];
+        int Column = std::min(Columns - 1, std::max(0, (int)((Window->X + Window->Width / 2.0 - Bounds.X) / CellWidth)));
+        int Row = std::min(Rows - 1, std::max(0, (int)((Window->Y + Window->Height / 2.0 - Bounds.Y) / CellHeight)));
+
+        // Widen the search ring until enough leaves are found, then take one more ring
+        // because a closer center can sit just across the cell border
+        Candidates.clear();
+        int LastRing = std::max(Columns, Rows);
+        for(int Ring = 0; Ring <= LastRing; ++Ring)
         {
-            while(!IsLeafNode(Root))
+            for(int CellRow = Row - Ring; CellRow <= Row + Ring; ++CellRow)
             {
-                if(!IsLeafNode(Root->LeftChild) && IsLeafNode(Root->RightChild))
-                    Root = Root->RightChild;
-                else
-                    Root = Root->LeftChild;
+                for(int CellColumn = Column - Ring; CellColumn <= Column + Ring; ++CellColumn)
+                {
+                    if(CellRow < 0 || CellRow >= Rows || CellColumn < 0 || CellColumn >= Columns)
+                        continue;
+
+                    if(std::abs(CellRow - Row) != Ring && std::abs(CellColumn - Column) != Ring)
+                        continue;
+
+                    const std::vector<std::size_t> &Cell = Cells[CellRow * Columns + CellColumn];
+                    for(std::size_t Index = 0; Index < Cell.size(); ++Index)
+                        Candidates.push_back(GetLeafAssignment(Leaves[Cell[Index]], Cell[Index], Window, WindowIndex));
+                }
             }
 
-            DEBUG("CreateBSPTree() Create pair of leafs")
-            CreateLeafNodePair(Screen, Root, Root->WindowID, Windows[WindowIndex]->WID, SplitModeOptimal);
-            Root = RootNode;
+            if(Candidates.size() >= LEAF_ASSIGNMENT_CANDIDATES && LastRing > Ring + 1)
+                LastRing = Ring + 1;
         }
 
-        Result = true;
+        std::size_t Count = std::min(Candidates.size(), (std::size_t)LEAF_ASSIGNMENT_CANDIDATES);
+        std::partial_sort(Candidates.begin(), Candidates.begin() + Count, Candidates.end(), IsLeafAssignmentBetter);
+        Pairs.insert(Pairs.end(), Candidates.begin(), Candidates.begin() + Count);
     }
-    else if(Windows.size() == 1)
+
+    std::sort(Pairs.begin(), Pairs.end(), IsLeafAssignmentBetter);
+
+    std::vector<bool> LeafTaken(Leaves.size(), false);
+    std::vector<bool> WindowTaken(Placed.size(), false);
+    std::size_t Moved = 0;
+    for(std::size_t PairIndex = 0; PairIndex < Pairs.size(); ++PairIndex)
     {
-        RootNode->WindowID = Windows[0]->WID;
-        Result = true;
+        const leaf_assignment &Pair = Pairs[PairIndex];
+        if(LeafTaken[Pair.Leaf] || WindowTaken[Pair.Window])
+            continue;
+
+        LeafTaken[Pair.Leaf] = true;
+        WindowTaken[Pair.Window] = true;
+        if(Leaves[Pair.Leaf]->WindowID != Placed[Pair.Window]->WID)
+        {
+            SetNodeWindowID(Space, Leaves[Pair.Leaf], Placed[Pair.Window]->WID);
+            ++Moved;
+        }
     }
 
-    return Result;
+    // A window whose candidates were all taken goes to the first free leaf
+    std::size_t FreeLeaf = 0;
+    for(std::size_t WindowIndex = 0; WindowIndex < Placed.size(); ++WindowIndex)
+    {
+        if(WindowTaken[WindowIndex])
+            continue;
+
+        while(LeafTaken[FreeLeaf])
+            ++FreeLeaf;
+
+        LeafTaken[FreeLeaf] = true;
+        if(Leaves[FreeLeaf]->WindowID != Placed[WindowIndex]->WID)
+        {
+            SetNodeWindowID(Space, Leaves[FreeLeaf], Placed[WindowIndex]->WID);
+            ++Moved;
+        }
+    }
+
+    // Leaves left over become pseudo leaves, a window may have moved away from them
+    for(std::size_t LeafIndex = 0; LeafIndex < Leaves.size(); ++LeafIndex)
+    {
+        if(!LeafTaken[LeafIndex] && Leaves[LeafIndex]->WindowID != -1)
+            SetNodeWindowID(Space, Leaves[LeafIndex], -1);
+    }
+
+    DEBUG("AssignWindowsToLeafNodes() " << Moved << " of " << Leaves.size() << " windows reassigned")
 }
 
-bool CreateMonocleTree(tree_node *RootNode, screen_info *Screen, const std::vector<window_info*> &Windows)
+bool IsLeafAssignmentBetter(const leaf_assignment &A, const leaf_assignment &B)
+{
+    if(A.Overlap != B.Overlap)
+        return A.Overlap > B.Overlap;
+
+    if(A.Distance != B.Distance)
+        return A.Distance < B.Distance;
+
+    return A.Leaf != B.Leaf ? A.Leaf < B.Leaf : A.Window < B.Window;
+}
+
+bool CreateMonocleTree(const layout_context &Context, space_info *Space, tree_node *RootNode, const std::vector<window_info*> &Windows)
 {
     Assert(RootNode, "CreateMonocleTree()")
 
@@ -75,86 +251,469 @@ bool CreateMonocleTree(tree_node *RootNode, screen_info *Screen, const std::vect
 
     if(!Windows.empty())
     {
-        tree_node *Root = RootNode;
-        Root->WindowID = Windows[0]->WID;
+        ClearWindowRing(&Space->Ring);
+
+        SetNodeWindowID(Space, RootNode, Windows[0]->WID);
+        AppendRingNode(&Space->Ring, RootNode);
 
         for(std::size_t WindowIndex = 1; WindowIndex < Windows.size(); ++WindowIndex)
         {
-            tree_node *Next = CreateRootNode(Screen);
-            Next->WindowID = Windows[WindowIndex]->WID;
-
-            Root->RightChild = Next;
-            Next->LeftChild = Root;
-            Root = Next;
+            tree_node *Node = CreateRootNode(Context, Space);
+            SetNodeWindowID(Space, Node, Windows[WindowIndex]->WID);
+            AppendRingNode(&Space->Ring, Node);
         }
 
+        UpdateRingLayout(Context, Space);
         Result = true;
     }
 
     return Result;
 }
 
-// TODO Add traversal function
-// foreach node in tree, if windowID != -1, ResizeWindowToContainerSize(Node)
 void ApplyNodeContainer(tree_node *Node, space_tiling_option Mode)
 {
-    if(Node)
+    tree_traversal Traversal;
+    BeginTreeTraversal(&Traversal, Node, Mode, TraversalPreOrder);
+    while((Node = NextTreeNode(&Traversal)))
     {
         if(Node->WindowID != -1)
             ResizeWindowToContainerSize(Node);
+    }
+}
+
+void ApplyNodeContainer(space_info *Space)
+{
+    if(!IsRingSpaceMode(Space->Mode))
+    {
+        ApplyNodeContainer(Space->RootNode, Space->Mode);
+        return;
+    }
+
+    if(Space->Mode != SpaceModeMonocle)
+    {
+        // A window that refuses to resize is floated and leaves the ring while
+        // the windows are resized, so walk a copy of the WindowIDs instead of the ring
+        std::vector<int> WindowIDs;
+        WindowIDs.reserve(Space->Ring.Nodes.size());
+        for(std::size_t Slot = 0; Slot < Space->Ring.Nodes.size(); ++Slot)
+        {
+            tree_node *Node = Space->Ring.Nodes[Slot];
+            if(Node && Node->WindowID != -1)
+                WindowIDs.push_back(Node->WindowID);
+        }
+
+        for(std::size_t Index = 0; Index < WindowIDs.size(); ++Index)
+        {
+            tree_node *Node = GetNodeFromWindowID(Space, WindowIDs[Index]);
+            if(Node)
+                ResizeWindowToContainerSize(Node);
+        }
+
+        return;
+    }
+
+    // Only the visible window is resized, the others wait until they gain focus
+    tree_node *Visible = Space->FocusedNode;
+    if(!Visible || Space->Ring.Slots.find(Visible) == Space->Ring.Slots.end())
+        Visible = GetFirstRingNode(&Space->Ring);
 
-        if(Mode == SpaceModeBSP && Node->LeftChild)
-            ApplyNodeContainer(Node->LeftChild, Mode);
+    for(std::size_t Slot = 0; Slot < Space->Ring.Nodes.size(); ++Slot)
+    {
+        tree_node *Node = Space->Ring.Nodes[Slot];
+        if(Node)
+            Node->Dirty = true;
+    }
+
+    ApplyPendingNodeContainer(Visible);
+}
 
-        if(Node->RightChild)
-            ApplyNodeContainer(Node->RightChild, Mode);
+void UpdateRingLayout(const layout_context &Context, space_info *Space)
+{
+    node_container Root;
+    SetRootNodeContainer(Context, &Root);
+
+    // Every container is rebuilt anyway, so the removed slots go first
+    CompactWindowRing(&Space->Ring);
+    ++Space->NeighbourGeneration;
+    int Count = Space->Ring.Nodes.size();
+    for(int Index = 0; Index < Count; ++Index)
+    {
+        tree_node *Node = Space->Ring.Nodes[Index];
+        if(Space->Mode == SpaceModeMaster)
+            Node->Container = CreateMasterStackContainer(Context, Root, Count, Index);
+        else if(Space->Mode == SpaceModeGrid)
+            Node->Container = CreateGridContainer(Context, Root, Count, Index);
+        else
+            Node->Container = Root;
     }
 }
 
-void ResizeTreeNodes(screen_info *Screen, tree_node *Root)
+void ApplyPendingNodeContainer(tree_node *Node)
 {
-    PreOrderTraversal(ResizeNodeContainer, Screen, Root);
+    if(Node && Node->Dirty)
+    {
+        Node->Dirty = false;
+        if(Node->WindowID != -1)
+            ResizeWindowToContainerSize(Node);
+    }
 }
 
-void DestroyNodeTree(tree_node *Node, space_tiling_option Mode)
+void UpdateDirtyTreeNodes(screen_info *Screen, tree_node *Root, std::vector<tree_node*> *Changed)
 {
-    if(Node)
+    if(!Root || (!Root->Dirty && !Root->DirtyChild))
+        return;
+
+    layout_context Context = CreateLayoutContext(Screen);
+    if(!Context.Constraints->empty())
+        UpdateTreeMinimumSizes(Context, Root);
+
+    // second: the container of the parent moved, or the parent itself was marked
+    std::vector<std::pair<tree_node*, bool> > Stack(1, std::make_pair(Root, false));
+    while(!Stack.empty())
     {
-        if(Mode == SpaceModeBSP && Node->LeftChild)
-            DestroyNodeTree(Node->LeftChild, Mode);
+        tree_node *Node = Stack.back().first;
+        bool Forced = Stack.back().second;
+        Stack.pop_back();
+
+        bool Recompute = Node->Dirty || Forced;
+        bool Moved = false;
+        if(Recompute)
+        {
+            node_container Old = Node->Container;
+            ResizeNodeContainer(Context, Node);
+            Moved = !IsContainerGeometryEqual(Old, Node->Container);
 
-        if(Node->RightChild)
-            DestroyNodeTree(Node->RightChild, Mode);
+            if(Node->WindowID != -1 && (Moved || Node->Dirty))
+                Changed->push_back(Node);
+        }
 
-        free(Node);
-        Node = NULL;
+        if(!IsLeafNode(Node))
+        {
+            bool ForceChildren = Recompute && (Moved || Node->Dirty);
+            if(ForceChildren || Node->RightChild->Dirty || Node->RightChild->DirtyChild)
+                Stack.push_back(std::make_pair(Node->RightChild, ForceChildren));
+
+            if(ForceChildren || Node->LeftChild->Dirty || Node->LeftChild->DirtyChild)
+                Stack.push_back(std::make_pair(Node->LeftChild, ForceChildren));
+        }
+
+        Node->Dirty = false;
+        Node->DirtyChild = false;
     }
 }
 
-void RotateTree(tree_node *Node, int Deg)
+bool ApplyDirtyNodeContainers(screen_info *Screen, tree_node *Root)
 {
-    if (Node == NULL || IsLeafNode(Node))
+    std::vector<tree_node*> Changed;
+    UpdateDirtyTreeNodes(Screen, Root, &Changed);
+
+    DEBUG("ApplyDirtyNodeContainers() " << Changed.size() << " windows changed")
+    for(std::size_t NodeIndex = 0; NodeIndex < Changed.size(); ++NodeIndex)
+        ResizeWindowToContainerSize(Changed[NodeIndex]);
+
+    if(!Changed.empty() && KWMScreen.MarkedWindow != -1)
+        UpdateBorder("marked");
+
+    return !Changed.empty();
+}
+
+void FlushTreeLayout(screen_info *Screen)
+{
+    if(!DoesSpaceExistInMapOfScreen(Screen))
+        return;
+
+    space_info *Space = GetActiveSpaceOfScreen(Screen);
+    tree_node *Root = Space->RootNode;
+    if(Space->PendingLayout)
+    {
+        DEBUG("FlushTreeLayout() Pending layout of space " << Screen->ActiveSpace)
+        Space->PendingLayout = false;
+
+        if(Space->Mode == SpaceModeBSP)
+        {
+            MarkNodeDirty(Root);
+        }
+        else if(IsRingSpaceMode(Space->Mode))
+        {
+            UpdateRingLayout(CreateLayoutContext(Screen, Space), Space);
+            ApplyNodeContainer(Space);
+        }
+    }
+
+    if(Space->Mode == SpaceModeBSP && Root && (Root->Dirty || Root->DirtyChild))
+    {
+        if(ApplyDirtyNodeContainers(Screen, Root))
+            ++Space->NeighbourGeneration;
+    }
+}
+
+void UpdateLeafGeometry(space_info *Space)
+{
+    if(Space->LeafGeometryGeneration == Space->NeighbourGeneration && !Space->LeafNodes.empty())
+        return;
+
+    std::vector<window_info> Frames;
+    Space->LeafNodes.clear();
+    for(tree_node *Node = GetFirstLeafNode(Space); Node; Node = GetNearestNodeToTheRight(Space, Node))
+    {
+        if(Node->WindowID == -1)
+            continue;
+
+        window_info Frame = {};
+        Frame.WID = Node->WindowID;
+        Frame.X = Node->Container.X;
+        Frame.Y = Node->Container.Y;
+        Frame.Width = Node->Container.Width;
+        Frame.Height = Node->Container.Height;
+
+        Space->LeafNodes.push_back(Node);
+        Frames.push_back(Frame);
+    }
+
+    BuildWindowGeometry(Frames, &Space->LeafGeometry);
+    Space->LeafGeometryGeneration = Space->NeighbourGeneration;
+}
+
+void UpdateNodeNeighbours(screen_info *Screen, space_info *Space, tree_node *Node)
+{
+    UpdateLeafGeometry(Space);
+
+    window_info Frame = {};
+    Frame.WID = Node->WindowID;
+    Frame.X = Node->Container.X;
+    Frame.Y = Node->Container.Y;
+    Frame.Width = Node->Container.Width;
+    Frame.Height = Node->Container.Height;
+
+    std::size_t Count = Space->LeafNodes.size();
+    std::vector<double> Distances(Count);
+    for(int Direction = 0; Direction < 8; ++Direction)
+    {
+        bool Wrap = Direction >= 4;
+        GetDirectedRectDistances(Space->LeafGeometry, Frame, (Direction % 4) * 90, Wrap,
+                                 Screen->Width, Screen->Height, Distances.data());
+
+        tree_node *Closest = NULL;
+        double MinDist = INT_MAX;
+        for(std::size_t Other = 0; Other < Count; ++Other)
+        {
+            if(Space->LeafNodes[Other] != Node && Distances[Other] < MinDist)
+            {
+                MinDist = Distances[Other];
+                Closest = Space->LeafNodes[Other];
+            }
+        }
+
+        if(Wrap)
+            Node->WrapNeighbour[Direction % 4] = Closest;
+        else
+            Node->Neighbour[Direction] = Closest;
+    }
+
+    Node->NeighbourGeneration = Space->NeighbourGeneration;
+}
+
+tree_node *GetNodeNeighbour(screen_info *Screen, space_info *Space, tree_node *Node, int Degrees, bool Wrap)
+{
+    if(Degrees < 0 || Degrees >= 360 || Degrees % 90 != 0)
+        return NULL;
+
+    if(Node->NeighbourGeneration != Space->NeighbourGeneration)
+        UpdateNodeNeighbours(Screen, Space, Node);
+
+    int Direction = Degrees / 90;
+    return Wrap ? Node->WrapNeighbour[Direction] : Node->Neighbour[Direction];
+}
+
+void FlushTreeLayout()
+{
+    std::map<unsigned int, screen_info>::iterator It;
+    for(It = KWMTiling.DisplayMap.begin(); It != KWMTiling.DisplayMap.end(); ++It)
+        FlushTreeLayout(&It->second);
+}
+
+void DestroyNodeTree(space_info *Space)
+{
+    if(Space)
+    {
+        ResetNodePool(&Space->Pool);
+        ClearWindowRing(&Space->Ring);
+        Space->WindowNodes.clear();
+        Space->RootNode = NULL;
+        Space->FocusedNode = NULL;
+    }
+}
+
+void RotateTree(tree_node *Root, int Deg)
+{
+    if (Root == NULL || IsLeafNode(Root))
         return;
 
     DEBUG("RotateTree() " << Deg << " degrees")
 
-    if((Deg == 90 && Node->Container.SplitMode == SplitModeVertical) ||
-       (Deg == 270 && Node->Container.SplitMode == SplitModeHorizontal) ||
-       Deg == 180)
+    tree_node *Before = GetFirstLeafNode(Root)->PrevLeaf;
+    tree_node *After = GetLastLeafNode(Root)->NextLeaf;
+
+    tree_traversal Traversal;
+    BeginTreeTraversal(&Traversal, Root, SpaceModeBSP, TraversalPreOrder);
+    while(tree_node *Node = NextTreeNode(&Traversal))
     {
-        tree_node *Temp = Node->LeftChild;
-        Node->LeftChild = Node->RightChild;
-        Node->RightChild = Temp;
-        Node->Container.SplitRatio = 1 - Node->Container.SplitRatio;
+        if(IsLeafNode(Node))
+            continue;
+
+        if((Deg == 90 && Node->Container.SplitMode == SplitModeVertical) ||
+           (Deg == 270 && Node->Container.SplitMode == SplitModeHorizontal) ||
+           Deg == 180)
+        {
+            tree_node *Temp = Node->LeftChild;
+            Node->LeftChild = Node->RightChild;
+            Node->RightChild = Temp;
+            Node->Container.SplitRatio = 1 - Node->Container.SplitRatio;
+        }
+
+        if(Deg != 180)
+            Node->Container.SplitMode = Node->Container.SplitMode == SplitModeHorizontal ? SplitModeVertical : SplitModeHorizontal;
     }
 
-    if(Deg != 180)
-        Node->Container.SplitMode = Node->Container.SplitMode == SplitModeHorizontal ? SplitModeVertical : SplitModeHorizontal;
+    LinkLeafNodes(Root, Before, After);
+}
+
+void LinkLeafNodes(tree_node *Root, tree_node *Before, tree_node *After)
+{
+    if(!Root)
+        return;
 
-    RotateTree(Node->LeftChild, Deg);
-    RotateTree(Node->RightChild, Deg);
+    tree_node *Prev = Before;
+    tree_traversal Traversal;
+    BeginTreeTraversal(&Traversal, Root, SpaceModeBSP, TraversalPreOrder);
+    while(tree_node *Node = NextTreeNode(&Traversal))
+    {
+        if(IsLeafNode(Node))
+        {
+            Node->PrevLeaf = Prev;
+            if(Prev)
+                Prev->NextLeaf = Node;
 
+            Prev = Node;
+        }
+        else
+        {
+            Node->PrevLeaf = NULL;
+            Node->NextLeaf = NULL;
+        }
+    }
 
+    Prev->NextLeaf = After;
+    if(After)
+        After->PrevLeaf = Prev;
+}
+
+void CountLeafNodes(tree_node *Root)
+{
+    tree_traversal Traversal;
+    BeginTreeTraversal(&Traversal, Root, SpaceModeBSP, TraversalPostOrder);
+    while(tree_node *Node = NextTreeNode(&Traversal))
+        Node->LeafCount = IsLeafNode(Node) ? 1 : Node->LeftChild->LeafCount + Node->RightChild->LeafCount;
+}
+
+void UpdateTreeMinimumSizes(const layout_context &Context, tree_node *Root)
+{
+    tree_traversal Traversal;
+    BeginTreeTraversal(&Traversal, Root, SpaceModeBSP, TraversalPostOrder);
+    while(tree_node *Node = NextTreeNode(&Traversal))
+        UpdateNodeMinimumSize(Context, Node);
+}
+
+void EqualizeBSPTree(space_info *Space)
+{
+    if(!Space->RootNode)
+        return;
+
+    tree_traversal Traversal;
+    BeginTreeTraversal(&Traversal, Space->RootNode, SpaceModeBSP, TraversalPreOrder);
+    while(tree_node *Node = NextTreeNode(&Traversal))
+    {
+        if(IsLeafNode(Node))
+            continue;
+
+        // A parent that did not move only lays out its children again when it is dirty itself
+        double SplitRatio = (double)Node->LeftChild->LeafCount / Node->LeafCount;
+        if(Node->Container.SplitRatio != SplitRatio)
+        {
+            Node->Container.SplitRatio = SplitRatio;
+            MarkNodeDirty(Node);
+        }
+    }
+}
+
+void RebalanceBSPTree(screen_info *Screen, space_info *Space)
+{
+    if(!Space->RootNode || IsLeafNode(Space->RootNode))
+        return;
+
+    // A tree with n leaves always has n - 1 parents, the same nodes are relinked
+    std::vector<tree_node*> Leaves;
+    std::vector<tree_node*> Parents;
+    tree_traversal Traversal;
+    BeginTreeTraversal(&Traversal, Space->RootNode, SpaceModeBSP, TraversalPreOrder);
+    while(tree_node *Node = NextTreeNode(&Traversal))
+    {
+        if(IsLeafNode(Node))
+            Leaves.push_back(Node);
+        else
+            Parents.push_back(Node);
+    }
+
+    DEBUG("RebalanceBSPTree() Rebuild tree of " << Leaves.size() << " leaves")
+    layout_context Context = CreateLayoutContext(Screen, Space);
+    tree_node *Root = Parents.back();
+    Parents.pop_back();
+
+    node_container Container;
+    SetRootNodeContainer(Context, &Container);
+
+    Root->Parent = NULL;
+    Space->RootNode = Root;
+    RebalanceBSPSubtree(Context, Root, Container, Leaves, &Parents, 0, Leaves.size());
+    ++Space->NeighbourGeneration;
+}
+
+void RebalanceBSPSubtree(const layout_context &Context, tree_node *Node, const node_container &Container, const std::vector<tree_node*> &Leaves, std::vector<tree_node*> *Parents, std::size_t First, std::size_t Count)
+{
+    // Every relinked node is laid out and its window resized by the next flush
+    Node->LeafCount = Count;
+    MarkNodeDirty(Node);
+    if(Count == 1)
+        return;
+
+    // A reused parent may have shown a window as parent container at its old position
+    Node->WindowID = -1;
+
+    // Container only decides the split, the geometry of Node is left to the flush
+    node_container Split = Container;
+    Split.SplitMode = GetOptimalSplitMode(Container);
+    Split.SplitRatio = Context.SplitRatio;
+    Node->Container.SplitMode = Split.SplitMode;
+    Node->Container.SplitRatio = Split.SplitRatio;
+    bool Vertical = Split.SplitMode == SplitModeVertical;
+
+    std::size_t LeftCount = (Count + 1) / 2;
+    std::size_t RightCount = Count - LeftCount;
+    Node->LeftChild = LeftCount == 1 ? Leaves[First] : Parents->back();
+    if(LeftCount != 1)
+        Parents->pop_back();
+
+    Node->RightChild = RightCount == 1 ? Leaves[First + LeftCount] : Parents->back();
+    if(RightCount != 1)
+        Parents->pop_back();
+
+    Node->LeftChild->Parent = Node;
+    Node->RightChild->Parent = Node;
+
+    RebalanceBSPSubtree(Context, Node->LeftChild, CreateNodeContainer(Context, Split, Vertical ? ContainerLeft : ContainerUpper),
+                        Leaves, Parents, First, LeftCount);
+    RebalanceBSPSubtree(Context, Node->RightChild, CreateNodeContainer(Context, Split, Vertical ? ContainerRight : ContainerLower),
+                        Leaves, Parents, First + LeftCount, RightCount);
 }
 
 void ToggleSubtreeSplitMode(screen_info *Screen, tree_node *Node)
@@ -162,26 +721,50 @@ void ToggleSubtreeSplitMode(screen_info *Screen, tree_node *Node)
     if(!Node || IsLeafNode(Node))
         return;
 
+    RecordTreeLayout(GetActiveSpaceOfScreen(Screen));
     ToggleNodeSplitMode(Node);
-    ResizeTreeNodes(Screen, Node);
-    ApplyNodeContainer(Node, SpaceModeBSP);
+    MarkNodeDirty(Node);
 }
 
-tree_node *GetNodeFromWindowID(tree_node *Node, int WindowID, space_tiling_option Mode)
+tree_node *GetNodeFromWindowID(space_info *Space, int WindowID)
 {
-    if(Node)
+    if(Space && WindowID != -1)
     {
-        tree_node *CurrentNode = GetFirstLeafNode(Node);;
-        while(CurrentNode)
+        std::unordered_map<int, tree_node*>::iterator It = Space->WindowNodes.find(WindowID);
+        if(It != Space->WindowNodes.end())
+            return It->second;
+    }
+
+    return NULL;
+}
+
+bool IsWindowIndexConsistent(space_info *Space)
+{
+    std::size_t IndexedNodes = 0;
+    tree_node *Node = GetFirstLeafNode(Space);
+    while(Node)
+    {
+        if(Node->WindowID != -1)
         {
-            if(CurrentNode->WindowID == WindowID)
-                return CurrentNode;
+            if(GetNodeFromWindowID(Space, Node->WindowID) != Node)
+            {
+                DEBUG("IsWindowIndexConsistent() Window " << Node->WindowID << " is not indexed to its node")
+                return false;
+            }
 
-            CurrentNode = GetNearestNodeToTheRight(CurrentNode, Mode);
+            ++IndexedNodes;
         }
+
+        Node = GetNearestNodeToTheRight(Space, Node);
     }
 
-    return NULL;
+    if(IndexedNodes != Space->WindowNodes.size())
+    {
+        DEBUG("IsWindowIndexConsistent() Index holds " << Space->WindowNodes.size() << " windows, tree holds " << IndexedNodes)
+        return false;
+    }
+
+    return true;
 }
 
 tree_node *GetFirstLeafNode(tree_node *Node)
@@ -221,13 +804,8 @@ tree_node *GetFirstPseudoLeafNode(tree_node *Node)
 
 tree_node *GetNearestLeafNeighbour(tree_node *Node, space_tiling_option Mode)
 {
-    if(Node && IsLeafNode(Node))
-    {
-        if(Mode == SpaceModeBSP)
-            return IsLeftLeaf(Node) ? GetNearestNodeToTheRight(Node, Mode) : GetNearestNodeToTheLeft(Node, Mode);
-        else if(Mode == SpaceModeMonocle)
-            return Node->LeftChild ? Node->LeftChild : Node->RightChild;
-    }
+    if(Node && IsLeafNode(Node) && Mode == SpaceModeBSP)
+        return IsLeftLeaf(Node) ? GetNearestNodeToTheRight(Node, Mode) : GetNearestNodeToTheLeft(Node, Mode);
 
     return NULL;
 }
@@ -236,8 +814,8 @@ tree_node *GetNearestNodeToTheLeft(tree_node *Node, space_tiling_option Mode)
 {
     if(Node)
     {
-        if(Mode == SpaceModeMonocle)
-            return Node->LeftChild;
+        if(Mode == SpaceModeBSP && IsLeafNode(Node))
+            return Node->PrevLeaf;
 
         if((Mode == SpaceModeBSP) && Node->Parent)
         {
@@ -259,8 +837,8 @@ tree_node *GetNearestNodeToTheRight(tree_node *Node, space_tiling_option Mode)
 {
     if(Node)
     {
-        if(Mode == SpaceModeMonocle)
-            return Node->RightChild;
+        if(Mode == SpaceModeBSP && IsLeafNode(Node))
+            return Node->NextLeaf;
 
         if((Mode == SpaceModeBSP) && Node->Parent)
         {
@@ -278,35 +856,168 @@ tree_node *GetNearestNodeToTheRight(tree_node *Node, space_tiling_option Mode)
     return NULL;
 }
 
-void PreOrderTraversal(void (*f)(screen_info *Screen, tree_node *Root), screen_info *Screen, tree_node *Root)
+tree_node *GetFirstLeafNode(space_info *Space)
+{
+    if(IsRingSpaceMode(Space->Mode))
+        return GetFirstRingNode(&Space->Ring);
+
+    return GetFirstLeafNode(Space->RootNode);
+}
+
+tree_node *GetLastLeafNode(space_info *Space)
+{
+    if(IsRingSpaceMode(Space->Mode))
+        return GetLastRingNode(&Space->Ring);
+
+    return GetLastLeafNode(Space->RootNode);
+}
+
+tree_node *GetNearestNodeToTheLeft(space_info *Space, tree_node *Node)
+{
+    if(IsRingSpaceMode(Space->Mode))
+        return GetPrevRingNode(&Space->Ring, Node);
+
+    return GetNearestNodeToTheLeft(Node, Space->Mode);
+}
+
+tree_node *GetNearestNodeToTheRight(space_info *Space, tree_node *Node)
+{
+    if(IsRingSpaceMode(Space->Mode))
+        return GetNextRingNode(&Space->Ring, Node);
+
+    return GetNearestNodeToTheRight(Node, Space->Mode);
+}
+
+void BeginTreeTraversal(tree_traversal *Traversal, tree_node *Root, space_tiling_option Mode, traversal_order Order)
 {
-    if(Root)
+    Traversal->Order = Order;
+    Traversal->Mode = Mode;
+    Traversal->Nodes.clear();
+    Traversal->Head = 0;
+    Traversal->Next = NULL;
+    Traversal->End = NULL;
+    Traversal->Visited = NULL;
+
+    if(!Root)
+        return;
+
+    if(IsRingSpaceMode(Mode))
+    {
+        Traversal->Next = Root;
+    }
+    else if(Order == TraversalLeafOrder)
+    {
+        Traversal->Next = GetFirstLeafNode(Root);
+        Traversal->End = GetLastLeafNode(Root);
+    }
+    else
     {
-        f(Screen, Root);
-        PreOrderTraversal(f, Screen, Root->LeftChild);
-        PreOrderTraversal(f, Screen, Root->RightChild);
+        Traversal->Nodes.push_back(Root);
     }
 }
 
-tree_node *LevelOrderSearch(bool (*is_match)(tree_node *Root), tree_node *Root)
+tree_node *NextTreeNode(tree_traversal *Traversal)
 {
-    std::queue<tree_node*> qNode;
-    
-    if(Root)
+    tree_node *Node = NULL;
+
+    // Ring nodes are unlinked, their order is kept by the window_ring of the space
+    if(IsRingSpaceMode(Traversal->Mode))
     {
-        for(qNode.push(Root); !qNode.empty(); qNode.pop())
+        Node = Traversal->Next;
+        Traversal->Next = NULL;
+        return Node;
+    }
+
+    switch(Traversal->Order)
+    {
+        case TraversalPreOrder:
         {
-            tree_node *Node = qNode.front();
+            if(!Traversal->Nodes.empty())
+            {
+                Node = Traversal->Nodes.back();
+                Traversal->Nodes.pop_back();
 
-            if(is_match(Node))
-                return Node;
-            
-            if(Node->LeftChild)
-                qNode.push(Node->LeftChild);
+                if(Node->RightChild)
+                    Traversal->Nodes.push_back(Node->RightChild);
 
-            if(Node->RightChild)
-                qNode.push(Node->RightChild);
-        }
+                if(Node->LeftChild)
+                    Traversal->Nodes.push_back(Node->LeftChild);
+            }
+        } break;
+        case TraversalPostOrder:
+        {
+            // Nodes holds the path from the root, Visited the node looked at last
+            while(!Traversal->Nodes.empty())
+            {
+                tree_node *Current = Traversal->Nodes.back();
+                tree_node *Prev = Traversal->Visited;
+                Traversal->Visited = Current;
+
+                if(!Prev || Prev->LeftChild == Current || Prev->RightChild == Current)
+                {
+                    if(Current->LeftChild)
+                    {
+                        Traversal->Nodes.push_back(Current->LeftChild);
+                        continue;
+                    }
+
+                    if(Current->RightChild)
+                    {
+                        Traversal->Nodes.push_back(Current->RightChild);
+                        continue;
+                    }
+                }
+                else if(Current->LeftChild == Prev && Current->RightChild)
+                {
+                    Traversal->Nodes.push_back(Current->RightChild);
+                    continue;
+                }
+
+                Traversal->Nodes.pop_back();
+                Node = Current;
+                break;
+            }
+        } break;
+        case TraversalLevelOrder:
+        {
+            if(Traversal->Head < Traversal->Nodes.size())
+            {
+                Node = Traversal->Nodes[Traversal->Head++];
+
+                if(Node->LeftChild)
+                    Traversal->Nodes.push_back(Node->LeftChild);
+
+                if(Node->RightChild)
+                    Traversal->Nodes.push_back(Node->RightChild);
+            }
+        } break;
+        case TraversalLeafOrder:
+        {
+            Node = Traversal->Next;
+            if(Node)
+                Traversal->Next = Node == Traversal->End ? NULL : Node->NextLeaf;
+        } break;
+    }
+
+    return Node;
+}
+
+void PreOrderTraversal(void (*f)(screen_info *Screen, tree_node *Root), screen_info *Screen, tree_node *Root)
+{
+    tree_traversal Traversal;
+    BeginTreeTraversal(&Traversal, Root, SpaceModeBSP, TraversalPreOrder);
+    while(tree_node *Node = NextTreeNode(&Traversal))
+        f(Screen, Node);
+}
+
+tree_node *LevelOrderSearch(bool (*is_match)(tree_node *Root), tree_node *Root)
+{
+    tree_traversal Traversal;
+    BeginTreeTraversal(&Traversal, Root, SpaceModeBSP, TraversalLevelOrder);
+    while(tree_node *Node = NextTreeNode(&Traversal))
+    {
+        if(is_match(Node))
+            return Node;
     }
 
     return NULL;
@@ -318,19 +1029,28 @@ void AddElementToBSPTree(screen_info *Screen, tree_node *NewParent, int WindowID
     {
         Assert((NewParent->WindowID !=-1), "AddNodeToTree()")
 
-        CreateLeafNodePair(Screen, NewParent, NewParent->WindowID, WindowID, SplitMode);
+        space_info *Space = GetActiveSpaceOfScreen(Screen);
+        CreateLeafNodePair(CreateLayoutContext(Screen, Space), Space, NewParent, NewParent->WindowID, WindowID, SplitMode);
+        MarkNodeDirty(NewParent->LeftChild);
+        MarkNodeDirty(NewParent->RightChild);
     }
 }
 
 void AddElementToMonocleTree(screen_info *Screen, tree_node *NewParent, int WindowID, const split_mode &SplitMode) // TODO replace WindowID with element
 {
-    Assert(!NewParent->RightChild, "AddElementToMonocleTree()")
-
-    tree_node *NewNode = CreateRootNode(Screen);
-
-    NewNode->WindowID = WindowID;
-    NewNode->LeftChild = NewParent;
-    NewParent->RightChild = NewNode;
+    space_info *Space = GetActiveSpaceOfScreen(Screen);
+    tree_node *NewNode = CreateRootNode(CreateLayoutContext(Screen, Space), Space);
+
+    SetNodeWindowID(Space, NewNode, WindowID);
+    AppendRingNode(&Space->Ring, NewNode);
+    if(!Space->RootNode)
+        Space->RootNode = NewNode;
+
+    // Every window of a master-stack or grid space moves when one is added
+    if(Space->Mode == SpaceModeMonocle)
+        ResizeWindowToContainerSize(NewNode);
+    else
+        Space->PendingLayout = true;
 }
 
 void AddElementToTree(screen_info *Screen, tree_node *NewParent, int WindowID, const split_mode &SplitMode, const space_tiling_option &Mode)
@@ -341,6 +1061,8 @@ void AddElementToTree(screen_info *Screen, tree_node *NewParent, int WindowID, c
             AddElementToBSPTree(Screen, NewParent, WindowID, SplitMode);
             break;
         case SpaceModeMonocle:
+        case SpaceModeMaster:
+        case SpaceModeGrid:
             AddElementToMonocleTree(Screen, NewParent, WindowID, SplitMode);
             break;
 
@@ -348,7 +1070,6 @@ void AddElementToTree(screen_info *Screen, tree_node *NewParent, int WindowID, c
             Assert(false, "AddElementToTree()")
             return;
     }
-    ApplyNodeContainer(NewParent, Mode);
 }
 
 void RemoveElementFromBSPTree(screen_info *Screen, tree_node *Node)
@@ -360,10 +1081,12 @@ void RemoveElementFromBSPTree(screen_info *Screen, tree_node *Node)
         tree_node *ResizeRoot = NULL;
 
         // case 1: Node == Root
+        SetNodeWindowID(Space, Node, -1);
+        UnlinkLeafNode(Node);
         if(!Parent)
         {
             Space->RootNode = NULL;
-            free(Node);
+            FreeNode(&Space->Pool, Node);
             return;
         }
 
@@ -372,6 +1095,7 @@ void RemoveElementFromBSPTree(screen_info *Screen, tree_node *Node)
         if (Parent == Space->RootNode)
         {
             Space->RootNode = Sibling;
+            Sibling->Parent = NULL;
             ResizeRoot = Space->RootNode;
         }
         else
@@ -382,15 +1106,15 @@ void RemoveElementFromBSPTree(screen_info *Screen, tree_node *Node)
             else
                 Grandparent->RightChild = Sibling;
 
+            Sibling->Parent = Grandparent;
             ResizeRoot = Grandparent;
-
+            UpdateLeafCount(Grandparent, -1);
         }
 
-        free(Node);
-        free(Parent);
+        FreeNode(&Space->Pool, Node);
+        FreeNode(&Space->Pool, Parent);
 
-        ResizeTreeNodes(Screen, ResizeRoot);
-        ApplyNodeContainer(ResizeRoot, Space->Mode);
+        MarkNodeDirty(ResizeRoot);
     }
 }
 
@@ -400,34 +1124,176 @@ void RemoveElementFromMonocleTree(screen_info *Screen, tree_node *Node)
     {
         space_info *Space = GetActiveSpaceOfScreen(Screen);
 
-        tree_node *Prev = Node->LeftChild;
-        tree_node *Next = Node->RightChild;
+        RemoveRingNode(&Space->Ring, Node);
+        if(Space->RootNode == Node)
+            Space->RootNode = GetFirstRingNode(&Space->Ring);
+
+        if(Space->FocusedNode == Node)
+            Space->FocusedNode = NULL;
+
+        if(Space->Mode != SpaceModeMonocle)
+            Space->PendingLayout = true;
+
+        SetNodeWindowID(Space, Node, -1);
+        FreeNode(&Space->Pool, Node);
+    }
+}
+
+// RemovedBefore is a Fenwick tree over the slots, a removed slot counts one
+std::size_t CountRemovedRingSlots(window_ring *Ring, std::size_t Slot)
+{
+    std::size_t Count = 0;
+    for(std::size_t Index = Slot; Index > 0; Index -= Index & (~Index + 1))
+        Count += Ring->RemovedBefore[Index - 1];
+
+    return Count;
+}
+
+void AppendRingNode(window_ring *Ring, tree_node *Node)
+{
+    Assert(Ring->Slots.find(Node) == Ring->Slots.end(), "AppendRingNode()")
 
-        if(Prev)
-            Prev->RightChild = Next;
+    std::size_t Slot = Ring->Nodes.size();
+    bool Empty = GetRingNodeCount(Ring) == 0;
+    std::size_t Covered = (Slot + 1) & (~(Slot + 1) + 1);
 
-        if(Next)
-            Next->LeftChild = Prev;
+    Ring->Slots[Node] = Slot;
+    Ring->Nodes.push_back(Node);
+    Ring->Prev.push_back(Empty ? RING_SLOT_NONE : Ring->Last);
+    Ring->Next.push_back(RING_SLOT_NONE);
+    Ring->RemovedBefore.push_back(CountRemovedRingSlots(Ring, Slot) - CountRemovedRingSlots(Ring, Slot + 1 - Covered));
 
-        if(!Prev) // root node of monocle tree
-            Space->RootNode = Next;
+    if(Empty)
+        Ring->First = Slot;
+    else
+        Ring->Next[Ring->Last] = Slot;
 
-        free(Node);
+    Ring->Last = Slot;
+}
+
+void RemoveRingNode(window_ring *Ring, tree_node *Node)
+{
+    std::unordered_map<tree_node*, std::size_t>::iterator It = Ring->Slots.find(Node);
+    if(It == Ring->Slots.end())
+        return;
+
+    // The slot is left empty and unlinked, so the nodes around it keep their slots and tab order
+    std::size_t Slot = It->second;
+    std::size_t Prev = Ring->Prev[Slot];
+    std::size_t Next = Ring->Next[Slot];
+    Ring->Slots.erase(It);
+    Ring->Nodes[Slot] = NULL;
+
+    if(Prev != RING_SLOT_NONE)
+        Ring->Next[Prev] = Next;
+    else
+        Ring->First = Next;
+
+    if(Next != RING_SLOT_NONE)
+        Ring->Prev[Next] = Prev;
+    else
+        Ring->Last = Prev;
+
+    for(std::size_t Index = Slot + 1; Index <= Ring->RemovedBefore.size(); Index += Index & (~Index + 1))
+        ++Ring->RemovedBefore[Index - 1];
+
+    ++Ring->Removed;
+    if(Ring->Removed * 2 > Ring->Nodes.size())
+        CompactWindowRing(Ring);
+}
+
+void CompactWindowRing(window_ring *Ring)
+{
+    if(Ring->Removed == 0)
+        return;
+
+    std::vector<tree_node*> Nodes;
+    Nodes.reserve(Ring->Nodes.size() - Ring->Removed);
+    for(std::size_t Slot = 0; Slot < Ring->Nodes.size(); ++Slot)
+    {
+        if(Ring->Nodes[Slot])
+            Nodes.push_back(Ring->Nodes[Slot]);
     }
+
+    ClearWindowRing(Ring);
+    for(std::size_t Slot = 0; Slot < Nodes.size(); ++Slot)
+        AppendRingNode(Ring, Nodes[Slot]);
+}
+
+void ClearWindowRing(window_ring *Ring)
+{
+    Ring->Nodes.clear();
+    Ring->Next.clear();
+    Ring->Prev.clear();
+    Ring->RemovedBefore.clear();
+    Ring->Slots.clear();
+    Ring->First = RING_SLOT_NONE;
+    Ring->Last = RING_SLOT_NONE;
+    Ring->Removed = 0;
+}
+
+tree_node *GetFirstRingNode(window_ring *Ring)
+{
+    return GetRingNodeCount(Ring) == 0 ? NULL : Ring->Nodes[Ring->First];
+}
+
+tree_node *GetLastRingNode(window_ring *Ring)
+{
+    return GetRingNodeCount(Ring) == 0 ? NULL : Ring->Nodes[Ring->Last];
+}
+
+tree_node *GetNextRingNode(window_ring *Ring, tree_node *Node)
+{
+    std::unordered_map<tree_node*, std::size_t>::iterator It = Ring->Slots.find(Node);
+    if(It != Ring->Slots.end() && Ring->Next[It->second] != RING_SLOT_NONE)
+        return Ring->Nodes[Ring->Next[It->second]];
+
+    return NULL;
 }
 
-void RemoveElementFromTree(screen_info *Screen, tree_node *Root, int WindowID, const space_tiling_option &Mode)
+tree_node *GetPrevRingNode(window_ring *Ring, tree_node *Node)
 {
-    if(Root)
+    std::unordered_map<tree_node*, std::size_t>::iterator It = Ring->Slots.find(Node);
+    if(It != Ring->Slots.end() && Ring->Prev[It->second] != RING_SLOT_NONE)
+        return Ring->Nodes[Ring->Prev[It->second]];
+
+    return NULL;
+}
+
+std::size_t GetRingNodeCount(window_ring *Ring)
+{
+    return Ring->Nodes.size() - Ring->Removed;
+}
+
+int GetRingNodePosition(window_ring *Ring, tree_node *Node)
+{
+    std::unordered_map<tree_node*, std::size_t>::iterator It = Ring->Slots.find(Node);
+    if(It == Ring->Slots.end())
+        return -1;
+
+    if(Ring->Removed == 0)
+        return static_cast<int>(It->second);
+
+    return static_cast<int>(It->second - CountRemovedRingSlots(Ring, It->second));
+}
+
+void RemoveElementFromTree(screen_info *Screen, int WindowID, const space_tiling_option &Mode)
+{
+    space_info *Space = GetActiveSpaceOfScreen(Screen);
+    if(Space->RootNode)
     {
-        tree_node *Node = GetNodeFromWindowID(Root, WindowID, Mode);
-        
+        tree_node *Node = GetNodeFromWindowID(Space, WindowID);
+        ClearWindowFrameCache(WindowID);
+        ClearWindowConstraint(WindowID);
+
         switch(Mode)
         {
             case SpaceModeBSP:
                 RemoveElementFromBSPTree(Screen, Node);
                 break;
             case SpaceModeMonocle:
+            case SpaceModeMaster:
+            case SpaceModeGrid:
                 RemoveElementFromMonocleTree(Screen, Node);
                 break;
 
@@ -440,12 +1306,228 @@ void RemoveElementFromTree(screen_info *Screen, tree_node *Root, int WindowID, c
 
 void ModifySubtreeSplitRatio(screen_info *Screen, tree_node *Root, const double &Offset)
 {
-    if(Root && ModifyNodeSplitRatio(Root->Parent, Offset))
+    if(Root && Root->Parent)
     {
         space_info *Space = GetActiveSpaceOfScreen(Screen);
+        flat_tree Layout;
+        FlattenNodeTree(Space->RootNode, &Layout);
+
+        if(ModifyNodeSplitRatio(Root->Parent, Offset))
+        {
+            PushTreeLayout(Space, Layout);
+            MarkNodeDirty(Root->Parent);
+        }
+    }
+}
+
+
+void FlattenNodeTree(tree_node *Root, flat_tree *Tree)
+{
+    Tree->Nodes.clear();
+    if(!Root)
+        return;
+
+    // first: node to copy, second: index of its parent
+    std::vector<std::pair<tree_node*, unsigned int> > Stack(1, std::make_pair(Root, FLAT_NODE_NONE));
+    while(!Stack.empty())
+    {
+        tree_node *Node = Stack.back().first;
+        unsigned int Parent = Stack.back().second;
+        Stack.pop_back();
+
+        unsigned int Index = Tree->Nodes.size();
+        flat_node Flat;
+        Flat.WindowID = Node->WindowID;
+        Flat.Parent = Parent;
+        Flat.LeftChild = FLAT_NODE_NONE;
+        Flat.RightChild = FLAT_NODE_NONE;
+        Flat.SplitRatio = Node->Container.SplitRatio;
+        Flat.SplitMode = Node->Container.SplitMode;
+        Flat.Type = Node->Container.Type;
+        Tree->Nodes.push_back(Flat);
+
+        if(Parent != FLAT_NODE_NONE)
+        {
+            if(IsLeftChild(Node))
+                Tree->Nodes[Parent].LeftChild = Index;
+            else
+                Tree->Nodes[Parent].RightChild = Index;
+        }
 
-        ResizeTreeNodes(Screen, Root->Parent);
-        ApplyNodeContainer(Root->Parent, Space->Mode);
+        if(!IsLeafNode(Node))
+        {
+            Stack.push_back(std::make_pair(Node->RightChild, Index));
+            Stack.push_back(std::make_pair(Node->LeftChild, Index));
+        }
     }
 }
 
+tree_node *CreateTreeFromFlatTree(screen_info *Screen, const flat_tree &Tree)
+{
+    if(Tree.Nodes.empty())
+        return NULL;
+
+    space_info *Space = GetActiveSpaceOfScreen(Screen);
+    layout_context Context = CreateLayoutContext(Screen, Space);
+    std::vector<tree_node*> Nodes(Tree.Nodes.size(), NULL);
+    for(std::size_t Index = 0; Index < Tree.Nodes.size(); ++Index)
+    {
+        const flat_node &Flat = Tree.Nodes[Index];
+        tree_node *Node = NULL;
+        if(Flat.Parent == FLAT_NODE_NONE)
+        {
+            Node = CreateRootNode(Context, Space);
+        }
+        else
+        {
+            tree_node *Parent = Nodes[Flat.Parent];
+            Node = CreateLeafNode(Context, Space, Parent, -1, Flat.Type);
+            if(Tree.Nodes[Flat.Parent].LeftChild == Index)
+                Parent->LeftChild = Node;
+            else
+                Parent->RightChild = Node;
+        }
+
+        if(IsFlatLeafNode(Flat))
+        {
+            SetNodeWindowID(Space, Node, Flat.WindowID);
+        }
+        else
+        {
+            Node->Container.SplitMode = Flat.SplitMode;
+            Node->Container.SplitRatio = Flat.SplitRatio;
+        }
+
+        Nodes[Index] = Node;
+    }
+
+    // A parent holds the window shown in its container by ToggleFocusedWindowParentContainer()
+    for(std::size_t Index = 0; Index < Tree.Nodes.size(); ++Index)
+    {
+        const flat_node &Flat = Tree.Nodes[Index];
+        if(!IsFlatLeafNode(Flat) && GetNodeFromWindowID(Space, Flat.WindowID))
+            Nodes[Index]->WindowID = Flat.WindowID;
+    }
+
+    CountLeafNodes(Nodes[0]);
+    LinkLeafNodes(Nodes[0], NULL, NULL);
+    return Nodes[0];
+}
+
+void RecordTreeLayout(space_info *Space)
+{
+    if(Space->Mode != SpaceModeBSP || !Space->RootNode)
+        return;
+
+    flat_tree Layout;
+    FlattenNodeTree(Space->RootNode, &Layout);
+    PushTreeLayout(Space, Layout);
+}
+
+void PushTreeLayout(space_info *Space, const flat_tree &Layout)
+{
+    if(Space->UndoLayouts.size() == LAYOUT_JOURNAL_SIZE)
+        Space->UndoLayouts.erase(Space->UndoLayouts.begin());
+
+    Space->UndoLayouts.push_back(Layout);
+    Space->RedoLayouts.clear();
+}
+
+bool IsTreeLayoutCompatible(space_info *Space, const flat_tree &Layout)
+{
+    std::size_t Windows = 0;
+    for(unsigned int Index = GetFirstFlatLeafNode(Layout);
+        Index != FLAT_NODE_NONE;
+        Index = GetNextFlatLeafNode(Layout, Index))
+    {
+        int WindowID = Layout.Nodes[Index].WindowID;
+        if(WindowID == -1)
+            continue;
+
+        if(!GetNodeFromWindowID(Space, WindowID))
+            return false;
+
+        ++Windows;
+    }
+
+    return Windows == Space->WindowNodes.size();
+}
+
+bool RestoreTreeLayout(screen_info *Screen, const flat_tree &Layout)
+{
+    space_info *Space = GetActiveSpaceOfScreen(Screen);
+    if(!IsTreeLayoutCompatible(Space, Layout))
+    {
+        DEBUG("RestoreTreeLayout() Windows changed since the layout was recorded, dropping journal")
+        Space->UndoLayouts.clear();
+        Space->RedoLayouts.clear();
+        return false;
+    }
+
+    int FocusedWindowID = Space->FocusedNode ? Space->FocusedNode->WindowID : -1;
+    DestroyNodeTree(Space);
+    Space->RootNode = CreateTreeFromFlatTree(Screen, Layout);
+    Space->FocusedNode = GetNodeFromWindowID(Space, FocusedWindowID);
+
+    ApplyNodeContainer(Space->RootNode, Space->Mode);
+    UpdateBorder("marked");
+    return true;
+}
+
+bool UndoTreeLayout(screen_info *Screen)
+{
+    space_info *Space = GetActiveSpaceOfScreen(Screen);
+    if(Space->Mode != SpaceModeBSP || !Space->RootNode || Space->UndoLayouts.empty())
+        return false;
+
+    flat_tree Current;
+    FlattenNodeTree(Space->RootNode, &Current);
+
+    flat_tree Layout = Space->UndoLayouts.back();
+    Space->UndoLayouts.pop_back();
+    if(!RestoreTreeLayout(Screen, Layout))
+        return false;
+
+    Space->RedoLayouts.push_back(Current);
+    return true;
+}
+
+bool RedoTreeLayout(screen_info *Screen)
+{
+    space_info *Space = GetActiveSpaceOfScreen(Screen);
+    if(Space->Mode != SpaceModeBSP || !Space->RootNode || Space->RedoLayouts.empty())
+        return false;
+
+    flat_tree Current;
+    FlattenNodeTree(Space->RootNode, &Current);
+
+    flat_tree Layout = Space->RedoLayouts.back();
+    Space->RedoLayouts.pop_back();
+    if(!RestoreTreeLayout(Screen, Layout))
+        return false;
+
+    Space->UndoLayouts.push_back(Current);
+    return true;
+}
+
+bool IsFlatLeafNode(const flat_node &Node)
+{
+    return Node.LeftChild == FLAT_NODE_NONE && Node.RightChild == FLAT_NODE_NONE;
+}
+
+unsigned int GetFirstFlatLeafNode(const flat_tree &Tree)
+{
+    return GetNextFlatLeafNode(Tree, FLAT_NODE_NONE);
+}
+
+unsigned int GetNextFlatLeafNode(const flat_tree &Tree, unsigned int Index)
+{
+    // FLAT_NODE_NONE + 1 wraps to the first node
+    for(++Index; Index < Tree.Nodes.size(); ++Index)
+    {
+        if(IsFlatLeafNode(Tree.Nodes[Index]))
+            return Index;
+    }
+
+    return FLAT_NODE_NONE;
+}
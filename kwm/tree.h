@@ -10,7 +10,7 @@
     Map:
         std::vector<window_info*> -> Tree
     Input:
-        Screen - used to determine the mode (BSP or Monocle)
+        Screen - used to determine the mode (BSP, Monocle, Master or Grid)
         WindowsPtr - list of windows to put in the tree.
     Output:
         tree_node - Root of full tree.
@@ -21,36 +21,75 @@ tree_node *CreateTreeFromWindowIDList(screen_info *Screen, const std::vector<win
     Map:
         std::vector<window_info*> -> Tree
     Input:
+        Context - pass through to create Containers.
+        Space - owner of the node_pool and WindowID index.
         RootNode - the root of the BSP tree to be created.
-        Screen - pass through to create Containers.
         WindowsPtr - list of windows to put in the tree.
     Output:
         tree_node* RootNode - mutate the RootNode to populate with children created in this function.
         bool - Success status of the tree creation process.
 */
-bool CreateBSPTree(tree_node *RootNode, screen_info *Screen, const std::vector<window_info*> &Windows);
+bool CreateBSPTree(const layout_context &Context, space_info *Space, tree_node *RootNode, const std::vector<window_info*> &Windows);
+
+/* Replace a leaf with a balanced BSP subtree holding a range of windows.
+   The left half of every split receives the extra window of an odd count,
+   containers are created once top-down and the new leaves take the place
+   of Leaf in the leaf list.
+    Map:
+        std::vector<window_info*>[First, First + Count) -> Subtree
+    Input:
+        Context - pass through to create Containers.
+        Space - owner of the node_pool and WindowID index.
+        Leaf - leaf to expand, its Container must be valid.
+        Windows - list of windows, in left-to-right leaf order.
+        First - index of the first window to place.
+        Count - number of windows to place, at least one.
+    Output:
+        tree_node *Leaf - mutate into the root of the new subtree.
+*/
+void CreateBalancedBSPTree(const layout_context &Context, space_info *Space, tree_node *Leaf, const std::vector<window_info*> &Windows, std::size_t First, std::size_t Count);
+void CreateBalancedBSPSubtree(const layout_context &Context, space_info *Space, tree_node *Node, const std::vector<window_info*> &Windows, std::size_t First, std::size_t Count);
+
+/* Move the windows of a freshly built tree between its leaves so that every
+   window lands in the leaf closest to its current frame. Empty leaves are
+   candidates too. Leaf centers are bucketed in a grid and every window only
+   scores the LEAF_ASSIGNMENT_CANDIDATES best leaves of the cells around it.
+   Pairs are taken greedily by largest overlap, then by nearest center,
+   which keeps windows in place when the new layout resembles the old one.
+    Input:
+        Space - owner of the WindowID index
+        Root - tree whose leaves hold the windows
+        Windows - current frames of the windows in the tree
+    Output:
+        tree_node *Root - WindowIDs of the leaves are permuted.
+*/
+void AssignWindowsToLeafNodes(space_info *Space, tree_node *Root, const std::vector<window_info*> &Windows);
+leaf_assignment GetLeafAssignment(tree_node *Leaf, std::size_t LeafIndex, const window_info *Window, std::size_t WindowIndex);
+bool IsLeafAssignmentBetter(const leaf_assignment &A, const leaf_assignment &B);
 
 /* Create a Monocle Tree starting at the root node from a list of windows.
+   Master-stack and grid spaces use the same window_ring, only their
+   containers differ, see UpdateRingLayout().
     Map:
-        std::vector<window_info*> -> Tree
+        std::vector<window_info*> -> window_ring
     Intput:
-        RootNode - the root of the Monocle tree to be created.
-        Screen - pass through to create Containers.
+        Context - pass through to create Containers.
+        Space - owner of the window_ring.
+        RootNode - the first node of the Monocle tree to be created.
         WindowsPtr - list of windows to put in the tree.
     Output:
-        tree_node* RootNode - mutate the RootNode to populate with children created in this function.
+        window_ring Space->Ring - replaced by RootNode and one node per remaining window.
         bool - Success status of the tree creation process.
 */
-bool CreateMonocleTree(tree_node *RootNode, screen_info *Screen, const std::vector<window_info*> &Windows);
+bool CreateMonocleTree(const layout_context &Context, space_info *Space, tree_node *RootNode, const std::vector<window_info*> &Windows);
 
-/* Recursively destroy the subtree and deallocate memory starting at Node
+/* Destroy the tree of a space by resetting its node_pool
     Input:
-        Node - root of the subtree to destroy
-        Mode - whether the tree is BSP or Monocle
+        Space - owner of the tree and of the node_pool it was allocated from
     Output:
-        Node - destroy Node and all Nodes in subtree.
+        Space - RootNode and FocusedNode are cleared, every node is released.
 */
-void DestroyNodeTree(tree_node *Node, space_tiling_option Mode);
+void DestroyNodeTree(space_info *Space);
 
 void AddElementToBSPTree(screen_info *Screen, tree_node *NewParent, int WindowID, const split_mode &SplitMode);
 void AddElementToMonocleTree(screen_info *Screen, tree_node *NewParent, int WindowID, const split_mode &SplitMode);
@@ -59,21 +98,80 @@ void AddElementToTree(screen_info *Screen, tree_node *NewParent, int WindowID, c
 
 void RemoveElementFromBSPTree(screen_info *Screen, tree_node *Node);
 void RemoveElementFromMonocleTree(screen_info *Screen, tree_node *Node);
-void RemoveElementFromTree(screen_info *Screen, tree_node *Root, int WindowID, const space_tiling_option &Mode);
+void RemoveElementFromTree(screen_info *Screen, int WindowID, const space_tiling_option &Mode);
+
+/* Monocle spaces keep their nodes in a window_ring, in tab order.
+   Monocle nodes are unlinked roots that all hold the container of the display.
+   Nodes are appended to slots in tab order and the live slots are linked
+   through Next/Prev, so first/last, next/prev and removal are O(1).
+   A removed node leaves its slot empty and unlinked; the nodes after it keep
+   their slots, which keeps tab order. The empty slots are dropped when the
+   ring is rebuilt by UpdateRingLayout(), or once they make up half of the
+   ring, so removal stays O(1) amortized. Reads never compact the ring.
+   The position of a node is its slot while no slot is empty, otherwise the
+   empty slots before it are counted in O(log n) through RemovedBefore.
+    Input:
+        Ring - window_ring of a monocle space
+        Node - node in the ring
+    Output:
+        GetRingNodePosition() - zero-based tab position of Node, -1 if not in the ring
+*/
+void AppendRingNode(window_ring *Ring, tree_node *Node);
+void RemoveRingNode(window_ring *Ring, tree_node *Node);
+void CompactWindowRing(window_ring *Ring);
+std::size_t CountRemovedRingSlots(window_ring *Ring, std::size_t Slot);
+void ClearWindowRing(window_ring *Ring);
+tree_node *GetFirstRingNode(window_ring *Ring);
+tree_node *GetLastRingNode(window_ring *Ring);
+tree_node *GetNextRingNode(window_ring *Ring, tree_node *Node);
+tree_node *GetPrevRingNode(window_ring *Ring, tree_node *Node);
+std::size_t GetRingNodeCount(window_ring *Ring);
+int GetRingNodePosition(window_ring *Ring, tree_node *Node);
 
-/* Recursively swap left and right children according to Deg
+/* Swap left and right children in a subtree according to Deg
     Input:
-        Node - root of the subtree to start swapping
+        Root - root of the subtree to start swapping
         Deg - number of degrees to rotate (valid 90, 180, 270)
             90:  Rotate right, switch from SplitModeVertical to SplitModeHorizontal
             180: Keep split mode, just swap windows.
             270: Rotate left, switch from SplitModeHorizontal to SplitModeVertical
     Output:
-        tree_node *Node - mutate LeftChild, RightChild, and Container for every node in subtree.
+        tree_node *Root - mutate LeftChild, RightChild, and Container for every node in subtree,
+                          relink the leaves of the subtree.
 */
-void RotateTree(tree_node *Node, int Deg);
+void RotateTree(tree_node *Root, int Deg);
 
-/* Recursively resize all windows in nodes in subtree 
+/* Rebuild the PrevLeaf/NextLeaf list of a BSP subtree in-order
+    Input:
+        Root - subtree whose leaves are relinked
+        Before - leaf preceding the subtree, or NULL
+        After - leaf following the subtree, or NULL
+    Output:
+        tree_node *Root - mutate PrevLeaf and NextLeaf of every leaf in the subtree
+*/
+void LinkLeafNodes(tree_node *Root, tree_node *Before, tree_node *After);
+
+/* Recompute LeafCount of every node in a subtree built in bulk */
+void CountLeafNodes(tree_node *Root);
+
+/* Recompute MinWidth/MinHeight of every node in one post-order pass */
+void UpdateTreeMinimumSizes(const layout_context &Context, tree_node *Root);
+
+/* Even out a BSP space in one pass, laid out by the next FlushTreeLayout().
+   EqualizeBSPTree() sets the split-ratio of every parent to the share of
+   leaves on its left, so every window gets the same area.
+   RebalanceBSPTree() relinks the same nodes into a tree of minimum depth,
+   keeping the windows in their left-to-right order.
+    Input:
+        Screen, Space - space whose tree is changed
+    Output:
+        tree_node *Space->RootNode - mutate SplitRatio, or the shape of the tree
+*/
+void EqualizeBSPTree(space_info *Space);
+void RebalanceBSPTree(screen_info *Screen, space_info *Space);
+void RebalanceBSPSubtree(const layout_context &Context, tree_node *Node, const node_container &Container, const std::vector<tree_node*> &Leaves, std::vector<tree_node*> *Parents, std::size_t First, std::size_t Count);
+
+/* Resize all windows in nodes in subtree 
     Map:
         Window Resize -> tree
     Input:
@@ -84,17 +182,79 @@ void RotateTree(tree_node *Node, int Deg);
 */
 void ApplyNodeContainer(tree_node *Node, space_tiling_option Mode);
 
-/* Recursively resize all node containers in nodes in subtree.
+/* Resize every window of a space.
+   Master-stack and grid windows are all resized.
+   Monocle windows all share the root container and hide each other, so only
+   the focused (or first) window of the ring is resized. The other nodes are
+   marked Dirty, which in a monocle space means geometry pending, and
+   ApplyPendingNodeContainer() resizes them once they gain focus.
+*/
+void ApplyNodeContainer(space_info *Space);
+void ApplyPendingNodeContainer(tree_node *Node);
+
+/* Lay out every node of a monocle, master-stack or grid space in one pass
+   over its window_ring. Adding or removing a window of a master-stack or
+   grid space sets Space->PendingLayout, FlushTreeLayout() calls this once.
     Map:
-        Container Resize -> tree
+        window_ring -> node_container
+    Input:
+        Context - screen frame, offsets, master count and ratio of the space
+        Space - mode and window_ring of the space, compacted first
+    Output:
+        tree_node - Container of every ring node
+*/
+void UpdateRingLayout(const layout_context &Context, space_info *Space);
+
+/* Recompute the containers of dirty nodes in a BSP tree.
+   Only the paths flagged DirtyChild are walked. A recomputed node forces its
+   children when its geometry moved or it was marked itself, so a ratio change
+   costs the subtree below the modified split.
+    Map:
+        Container Resize -> dirty subtrees
     Input:
         Screen - passthrough to container functions
-        Root - the root node of the tree to resize containers for,
-               based off of Root.Container
+        Root - the root node of the tree
     Output:
-        tree_node *Root - mutate the containers of all nodes in the tree starting from Root.
+        tree_node *Root - mutate containers of dirty subtrees, clear dirty flags.
+        Changed - nodes holding a window whose geometry moved or that were marked.
  */
-void ResizeTreeNodes(screen_info *Screen, tree_node *Root);
+void UpdateDirtyTreeNodes(screen_info *Screen, tree_node *Root, std::vector<tree_node*> *Changed);
+
+/* UpdateDirtyTreeNodes() and resize the windows of the changed nodes */
+bool ApplyDirtyNodeContainers(screen_info *Screen, tree_node *Root);
+
+/* Tree mutations only mark nodes dirty; the layout of a space is applied
+   here, once per monitor tick, once per command and before the cursor is
+   moved onto a window, so every affected window is resized once.
+   Only the active space of a display is flushed. A space marked PendingLayout
+   (its display changed while it was hidden) gets all its containers rebuilt
+   the first time it is flushed, which UpdateActiveSpace() and
+   UpdateActiveScreen() do as soon as it is shown.
+    Input:
+        Screen - display whose active space is flushed, all displays if omitted
+*/
+void FlushTreeLayout(screen_info *Screen);
+void FlushTreeLayout();
+
+/* Directional neighbours of a leaf that holds a window, indexed by
+   Degrees / 90 (North = 0, East = 1, South = 2, West = 3). They are scored
+   like FindClosestWindow() scores windows, but on the node containers.
+   Space->NeighbourGeneration is bumped whenever a container moved or a window
+   was assigned to or cleared from a node. Swapping two windows keeps the
+   table, it points at nodes. The first lookup of a leaf after a change packs
+   the leaf frames of the space once, O(n), and scores the n leaves against
+   that one leaf in the 8 directions, O(n). Later lookups are O(1). Nothing
+   is computed for leaves that are never looked up.
+    Input:
+        Screen - size used for the wrap variants
+        Space - space whose leaves are scored
+        Node, Degrees, Wrap - leaf and direction to look up
+    Output:
+        tree_node* - neighbouring leaf, NULL if there is none
+*/
+void UpdateLeafGeometry(space_info *Space);
+void UpdateNodeNeighbours(screen_info *Screen, space_info *Space, tree_node *Node);
+tree_node *GetNodeNeighbour(screen_info *Screen, space_info *Space, tree_node *Node, int Degrees, bool Wrap);
 
 /* Change split_mode for node, 
    recursively create new containers for subtree, and
@@ -117,10 +277,85 @@ tree_node *GetFirstLeafNode(tree_node *Node);   // left-most leaf
 tree_node *GetLastLeafNode(tree_node *Node);    // right-most leaf
 tree_node *GetNearestNodeToTheLeft(tree_node *Node, space_tiling_option Mode);
 tree_node *GetNearestNodeToTheRight(tree_node *Node, space_tiling_option Mode);
+/* Space variants, these follow the window_ring of monocle, master and grid spaces */
+tree_node *GetFirstLeafNode(space_info *Space);
+tree_node *GetLastLeafNode(space_info *Space);
+tree_node *GetNearestNodeToTheLeft(space_info *Space, tree_node *Node);
+tree_node *GetNearestNodeToTheRight(space_info *Space, tree_node *Node);
 tree_node *GetNearestLeafNeighbour(tree_node *Node, space_tiling_option Mode);
 tree_node *GetFirstPseudoLeafNode(tree_node *Node);
-tree_node *GetNodeFromWindowID(tree_node *Node, int WindowID, space_tiling_option Mode);
+tree_node *GetNodeFromWindowID(space_info *Space, int WindowID);
+/* Verify Space->WindowNodes against the leaves of the tree (debug builds) */
+bool IsWindowIndexConsistent(space_info *Space);
+
+/* Iterative traversal of a tree with an explicit stack or queue.
+   Monocle nodes are unlinked, a monocle walk only yields Root; the window_ring
+   of the space holds the others. TraversalLeafOrder follows the
+   PrevLeaf/NextLeaf list of a BSP tree.
+    Input:
+        Traversal - state of the walk, owned by the caller
+        Root - subtree to walk, may be NULL
+        Mode - SpaceModeBSP or SpaceModeMonocle
+        Order - pre-order, post-order, level-order or leaves only
+    Output:
+        NextTreeNode() - next node in the requested order, NULL when done.
+                         Pre-order and level-order queue the children of a
+                         node before returning it, so swapping them is safe.
+*/
+void BeginTreeTraversal(tree_traversal *Traversal, tree_node *Root, space_tiling_option Mode, traversal_order Order);
+tree_node *NextTreeNode(tree_traversal *Traversal);
+
 void PreOrderTraversal(void (*f)(screen_info *Screen, tree_node *Root), screen_info *Screen, tree_node *Root);
 tree_node *LevelOrderSearch(bool (*is_match)(tree_node *Root), tree_node *Root);
 
+/* Flat trees: the snapshots kept by the layout journal.
+   A BSP tree is copied into one vector in pre-order, children are referenced
+   by index and only the split is kept; geometry is recomputed from the
+   display when a tree is rebuilt. Every parent precedes its children and
+   leaves appear left to right, so leaf iteration is a forward pass. */
+
+/* Copy a BSP tree into a flat_tree
+    Map:
+        Tree -> flat_tree
+    Input:
+        Root - root of the BSP tree
+    Output:
+        flat_tree *Tree - replaced by the nodes of Root in pre-order
+*/
+void FlattenNodeTree(tree_node *Root, flat_tree *Tree);
+
+/* Build a BSP tree of the active space of Screen from a flat_tree.
+   The WindowID index and the leaf list of the space are updated.
+    Map:
+        flat_tree -> Tree
+    Input:
+        Screen - used to create containers
+        Tree - flat tree to copy
+    Output:
+        tree_node* - root of the new tree, NULL for an empty flat_tree
+*/
+tree_node *CreateTreeFromFlatTree(screen_info *Screen, const flat_tree &Tree);
+
+/* Layout journal: flat snapshots of a BSP space taken before every user edit
+   (rotate, swap, detach-reinsert, split toggle and ratio change).
+   At most LAYOUT_JOURNAL_SIZE steps are kept. A snapshot is only restored
+   when it holds exactly the windows of the current tree, otherwise the
+   journal of the space is dropped. Restoring resizes only windows whose
+   frame differs, through the window frame cache.
+    Input:
+        Space/Screen - space whose journal is used, the active space of Screen
+    Output:
+        bool - a layout was restored
+*/
+void RecordTreeLayout(space_info *Space);
+void PushTreeLayout(space_info *Space, const flat_tree &Layout);
+bool UndoTreeLayout(screen_info *Screen);
+bool RedoTreeLayout(screen_info *Screen);
+bool RestoreTreeLayout(screen_info *Screen, const flat_tree &Layout);
+bool IsTreeLayoutCompatible(space_info *Space, const flat_tree &Layout);
+
+unsigned int GetFirstFlatLeafNode(const flat_tree &Tree);
+unsigned int GetNextFlatLeafNode(const flat_tree &Tree, unsigned int Index);
+bool IsFlatLeafNode(const flat_node &Node);
+
 #endif
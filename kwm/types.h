@@ -6,6 +6,7 @@
 #include <iostream>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <fstream>
 #include <sstream>
 #include <string>
@@ -30,11 +31,18 @@ struct container_offset;
 struct color;
 
 struct window_info;
+struct window_geometry;
 struct window_role;
 struct screen_info;
 struct space_info;
 struct node_container;
+struct layout_context;
+struct window_constraint;
+struct leaf_assignment;
 struct tree_node;
+struct node_pool;
+struct window_ring;
+struct window_index;
 
 struct kwm_mach;
 struct kwm_border;
@@ -61,6 +69,12 @@ struct kwm_thread;
     #define Assert(Expression, Function)
 #endif
 
+#define NODE_POOL_CHUNK_SIZE 64
+#define FLAT_NODE_NONE 0xFFFFFFFF
+#define RING_SLOT_NONE ((std::size_t)-1)
+#define LAYOUT_JOURNAL_SIZE 32
+#define LEAF_ASSIGNMENT_CANDIDATES 4
+
 #define BSP_WINDOW_EVENT_CALLBACK(name) void name(window_info *Window, int OpenWindows)
 typedef BSP_WINDOW_EVENT_CALLBACK(OnBSPWindowCreate);
 typedef BSP_WINDOW_EVENT_CALLBACK(OnBSPWindowDestroy);
@@ -100,6 +114,8 @@ enum space_tiling_option
     SpaceModeBSP,
     SpaceModeMonocle,
     SpaceModeFloating,
+    SpaceModeMaster,
+    SpaceModeGrid,
     SpaceModeDefault
 };
 
@@ -119,6 +135,14 @@ enum container_type
     ContainerLower
 };
 
+enum traversal_order
+{
+    TraversalPreOrder,
+    TraversalPostOrder,
+    TraversalLevelOrder,
+    TraversalLeafOrder
+};
+
 enum split_mode
 {
     SplitModeOptimal=-1,
@@ -174,6 +198,27 @@ struct node_container
     double SplitRatio;
 };
 
+struct window_constraint
+{
+    int MinWidth, MinHeight;
+    int MaxWidth, MaxHeight;
+    int RefusedWidth, RefusedHeight;
+    bool Probed;
+    bool Resizable;
+};
+
+struct layout_context
+{
+    double X, Y;
+    double Width, Height;
+    container_offset Offset;
+    double SplitRatio;
+    bool SpawnAsLeftChild;
+    int MasterCount;
+    double MasterRatio;
+    const std::unordered_map<int, window_constraint> *Constraints;
+};
+
 struct tree_node
 {
     int WindowID;
@@ -181,6 +226,77 @@ struct tree_node
     tree_node *Parent;
     tree_node *LeftChild;
     tree_node *RightChild;
+    tree_node *PrevLeaf;
+    tree_node *NextLeaf;
+
+    tree_node *Neighbour[4];
+    tree_node *WrapNeighbour[4];
+    unsigned int NeighbourGeneration;
+
+    int LeafCount;
+    double MinWidth, MinHeight;
+    bool Dirty;
+    bool DirtyChild;
+};
+
+struct flat_node
+{
+    int WindowID;
+    unsigned int Parent;
+    unsigned int LeftChild;
+    unsigned int RightChild;
+
+    float SplitRatio;
+    split_mode SplitMode;
+    container_type Type;
+};
+
+struct flat_tree
+{
+    std::vector<flat_node> Nodes;
+};
+
+struct leaf_assignment
+{
+    std::size_t Leaf;
+    std::size_t Window;
+    double Overlap;
+    double Distance;
+};
+
+struct tree_traversal
+{
+    traversal_order Order;
+    space_tiling_option Mode;
+
+    std::vector<tree_node*> Nodes;
+    std::size_t Head;
+    tree_node *Next;
+    tree_node *End;
+    tree_node *Visited;
+};
+
+struct node_pool
+{
+    std::vector<tree_node*> Chunks;
+    tree_node *FreeList;
+    std::size_t Chunk;
+    std::size_t Index;
+
+    unsigned int NodeCount;
+    unsigned int Allocations;
+    unsigned int HeapAllocations;
+};
+
+struct window_ring
+{
+    std::vector<tree_node*> Nodes;
+    std::vector<std::size_t> Next;
+    std::vector<std::size_t> Prev;
+    std::vector<std::size_t> RemovedBefore;
+    std::unordered_map<tree_node*, std::size_t> Slots;
+    std::size_t First, Last;
+    std::size_t Removed;
 };
 
 struct window_info
@@ -193,6 +309,12 @@ struct window_info
     int Width, Height;
 };
 
+struct window_geometry
+{
+    std::vector<int> X, Y;
+    std::vector<int> Width, Height;
+};
+
 struct window_role
 {
     CFTypeRef Role;
@@ -208,6 +330,18 @@ struct space_info
     space_tiling_option Mode;
     tree_node *FocusedNode;
     tree_node *RootNode;
+    node_pool Pool;
+    std::unordered_map<int, tree_node*> WindowNodes;
+    window_ring Ring;
+    bool PendingLayout;
+
+    unsigned int NeighbourGeneration;
+    unsigned int LeafGeometryGeneration;
+    std::vector<tree_node*> LeafNodes;
+    window_geometry LeafGeometry;
+
+    std::vector<flat_tree> UndoLayouts;
+    std::vector<flat_tree> RedoLayouts;
 };
 
 struct screen_info
@@ -221,7 +355,6 @@ struct screen_info
 
     int ActiveSpace;
     int OldWindowListCount;
-    bool ForceContainerUpdate;
     std::map<int, space_info> Space;
 };
 
@@ -287,6 +420,15 @@ struct kwm_focus
     window_info *Window;
     window_info Cache;
     window_info NULLWindowInfo;
+
+    kwm_time_point MouseTime;
+    kwm_time_point DwellTime;
+    CGPoint MouseCursor;
+    bool MousePending;
+    int DwellWindowID;
+
+    double MouseInterval;
+    double MouseDwell;
 };
 
 struct kwm_screen
@@ -295,6 +437,8 @@ struct kwm_screen
     bool ForceRefreshFocus;
     bool Transitioning;
     double SplitRatio;
+    int MasterCount;
+    double MasterRatio;
 
     int MarkedWindow;
     split_mode SplitMode;
@@ -319,13 +463,50 @@ struct kwm_tiling
 
     std::vector<window_info> FocusLst;
     std::vector<window_info> WindowLst;
+    window_geometry FocusGeometry;
+    window_geometry WindowGeometry;
     std::vector<int> FloatingWindowLst;
 };
 
+struct window_frame
+{
+    int X, Y;
+    int Width, Height;
+};
+
+struct applied_frame
+{
+    window_frame Target;
+    window_frame Reported;
+    bool ReportPending;
+};
+
+struct window_index
+{
+    int X, Y;
+    int CellSize;
+    int Columns, Rows;
+    std::vector<std::size_t> Targets;
+    std::vector<std::vector<std::size_t> > Cells;
+
+    int Hit;
+    bool HitUnoccluded;
+};
+
 struct kwm_cache
 {
     std::map<int, window_role> WindowRole;
     std::map<int, std::vector<AXUIElementRef> > WindowRefs;
+
+    std::unordered_map<int, applied_frame> WindowFrames;
+    std::unordered_map<int, window_constraint> WindowConstraints;
+    std::map<std::string, window_constraint> AppConstraints;
+    unsigned int ResizesIssued;
+    unsigned int ResizesSkipped;
+    unsigned int MouseMovesCoalesced;
+    unsigned int FocusChangesDeferred;
+
+    window_index FocusIndex;
 };
 
 struct kwm_mode
@@ -5,8 +5,11 @@
 #include "notifications.h"
 #include "border.h"
 #include "node.h"
+#include "geometry.h"
 
+#include <algorithm>
 #include <cmath>
+#include <climits>
 
 extern kwm_screen KWMScreen;
 extern kwm_focus KWMFocus;
@@ -107,6 +110,7 @@ bool FilterWindowList(screen_info *Screen)
     }
 
     KWMTiling.WindowLst = FilteredWindowLst;
+    BuildWindowGeometry(KWMTiling.WindowLst, &KWMTiling.WindowGeometry);
     return true;
 }
 
@@ -165,31 +169,14 @@ bool IsWindowFloating(int WindowID, int *Index)
 bool IsAnyWindowBelowCursor()
 {
     CGPoint Cursor = GetCursorPos();
-    for(std::size_t WindowIndex = 0; WindowIndex < KWMTiling.FocusLst.size(); ++WindowIndex)
-    {
-        window_info *Window = &KWMTiling.FocusLst[WindowIndex];
-        if(Cursor.x >= Window->X &&
-           Cursor.x <= Window->X + Window->Width &&
-           Cursor.y >= Window->Y &&
-           Cursor.y <= Window->Y + Window->Height)
-            return true;
-    }
-
-    return false;
+    return FindRectAtPoint(KWMTiling.FocusGeometry, std::floor(Cursor.x), std::floor(Cursor.y)) != -1;
 }
 
 bool IsWindowBelowCursor(window_info *Window)
 {
     Assert(Window, "IsWindowBelowCursor()")
 
-    CGPoint Cursor = GetCursorPos();
-    if(Cursor.x >= Window->X &&
-       Cursor.x <= Window->X + Window->Width &&
-       Cursor.y >= Window->Y &&
-       Cursor.y <= Window->Y + Window->Height)
-        return true;
-
-    return false;
+    return IsPointInsideWindow(GetCursorPos(), Window);
 }
 
 bool IsWindowOnActiveSpace(int WindowID)
@@ -262,7 +249,7 @@ void FocusFirstLeafNode()
         return;
 
     space_info *Space = GetActiveSpaceOfScreen(KWMScreen.Current);
-    SetWindowFocusByNode(GetFirstLeafNode(Space->RootNode));
+    SetWindowFocusByNode(GetFirstLeafNode(Space));
     MoveCursorToCenterOfFocusedWindow();
 }
 
@@ -272,36 +259,246 @@ void FocusLastLeafNode()
         return;
 
     space_info *Space = GetActiveSpaceOfScreen(KWMScreen.Current);
-    SetWindowFocusByNode(GetLastLeafNode(Space->RootNode));
+    SetWindowFocusByNode(GetLastLeafNode(Space));
     MoveCursorToCenterOfFocusedWindow();
 }
 
 void FocusWindowBelowCursor()
+{
+    FocusWindowBelowCursor(GetCursorPos());
+}
+
+void FocusWindowBelowCursor(CGPoint Cursor)
 {
     if(IsSpaceTransitionInProgress() ||
        !IsActiveSpaceManaged())
            return;
 
+    window_info *Window = GetFocusTargetAtPoint(Cursor);
+    if(Window)
+    {
+        if(!WindowsAreEqual(KWMFocus.Window, Window))
+            SetWindowFocus(Window);
+        else if(&KWMFocus.Cache != Window)
+            UpdateFocusedWindowCache(Window);
+    }
+}
+
+bool IsMouseMoveCoalesced(CGPoint Cursor)
+{
+    KWMFocus.MouseCursor = Cursor;
+    if(KWMFocus.MouseInterval <= 0)
+        return false;
+
+    kwm_time_point NewMouseTime = std::chrono::steady_clock::now();
+    std::chrono::duration<double> Diff = NewMouseTime - KWMFocus.MouseTime;
+    if(Diff.count() < KWMFocus.MouseInterval)
+    {
+        KWMFocus.MousePending = true;
+        ++KWMCache.MouseMovesCoalesced;
+        return true;
+    }
+
+    KWMFocus.MouseTime = NewMouseTime;
+    return false;
+}
+
+bool IsFocusChangeDeferred(window_info *Window)
+{
+    if(KWMFocus.MouseDwell <= 0)
+        return false;
+
+    kwm_time_point NewDwellTime = std::chrono::steady_clock::now();
+    if(KWMFocus.DwellWindowID != Window->WID)
+    {
+        KWMFocus.DwellWindowID = Window->WID;
+        KWMFocus.DwellTime = NewDwellTime;
+    }
+
+    std::chrono::duration<double> Diff = NewDwellTime - KWMFocus.DwellTime;
+    if(Diff.count() < KWMFocus.MouseDwell)
+    {
+        ++KWMCache.FocusChangesDeferred;
+        return true;
+    }
+
+    KWMFocus.DwellWindowID = -1;
+    return false;
+}
+
+void FocusWindowFollowingMouse(CGPoint Cursor)
+{
+    KWMFocus.MousePending = false;
+    UpdateActiveScreen(Cursor);
+
+    window_info *Window = NULL;
+    if(KWMMode.Focus != FocusModeDisabled &&
+       KWMMode.Focus != FocusModeStandby &&
+       !IsActiveSpaceFloating() &&
+       !IsSpaceTransitionInProgress() &&
+       IsActiveSpaceManaged())
+        Window = GetFocusTargetAtPoint(Cursor);
+
+    if(!Window)
+    {
+        KWMFocus.DwellWindowID = -1;
+        return;
+    }
+
+    if(WindowsAreEqual(KWMFocus.Window, Window))
+    {
+        KWMFocus.DwellWindowID = -1;
+        if(&KWMFocus.Cache != Window)
+            UpdateFocusedWindowCache(Window);
+    }
+    else if(!IsFocusChangeDeferred(Window))
+        SetWindowFocus(Window);
+}
+
+void CheckPendingMouseMove()
+{
+    if(KWMFocus.MousePending || KWMFocus.DwellWindowID != -1)
+    {
+        KWMFocus.MouseTime = std::chrono::steady_clock::now();
+        FocusWindowFollowingMouse(KWMFocus.MouseCursor);
+    }
+}
+
+void UpdateFocusedWindowCache(window_info *Window)
+{
+    // Names and owners are only copied when they changed, a mouse move does not allocate
+    if(KWMFocus.Cache.Name != Window->Name)
+        KWMFocus.Cache.Name = Window->Name;
+
+    if(KWMFocus.Cache.Owner != Window->Owner)
+        KWMFocus.Cache.Owner = Window->Owner;
+
+    KWMFocus.Cache.PID = Window->PID;
+    KWMFocus.Cache.WID = Window->WID;
+    KWMFocus.Cache.Layer = Window->Layer;
+    KWMFocus.Cache.X = Window->X;
+    KWMFocus.Cache.Y = Window->Y;
+    KWMFocus.Cache.Width = Window->Width;
+    KWMFocus.Cache.Height = Window->Height;
+}
+
+bool IsWindowFocusTarget(window_info *Window)
+{
+    if(Window->Owner == "kwm-overlay")
+        return false;
+
+    if(Window->Owner == "Dock" &&
+       Window->X == 0 &&
+       Window->Y == 0)
+        return false;
+
+    return ShouldWindowGainFocus(Window);
+}
+
+bool IsPointInsideWindow(CGPoint Point, window_info *Window)
+{
+    return Point.x >= Window->X &&
+           Point.x <= Window->X + Window->Width &&
+           Point.y >= Window->Y &&
+           Point.y <= Window->Y + Window->Height;
+}
+
+void UpdateWindowFocusIndex()
+{
+    window_index *Index = &KWMCache.FocusIndex;
+    Index->Targets.clear();
+    Index->Cells.clear();
+    Index->Columns = 0;
+    Index->Rows = 0;
+    Index->Hit = -1;
+
+    int Left = INT_MAX, Top = INT_MAX;
+    int Right = INT_MIN, Bottom = INT_MIN;
     for(std::size_t WindowIndex = 0; WindowIndex < KWMTiling.FocusLst.size(); ++WindowIndex)
     {
-        if(KWMTiling.FocusLst[WindowIndex].Owner == "kwm-overlay")
+        window_info *Window = &KWMTiling.FocusLst[WindowIndex];
+        if(!IsWindowFocusTarget(Window))
             continue;
 
-        if(KWMTiling.FocusLst[WindowIndex].Owner == "Dock" &&
-           KWMTiling.FocusLst[WindowIndex].X == 0 &&
-           KWMTiling.FocusLst[WindowIndex].Y == 0)
-            continue;
+        Index->Targets.push_back(WindowIndex);
+        Left = std::min(Left, Window->X);
+        Top = std::min(Top, Window->Y);
+        Right = std::max(Right, Window->X + Window->Width);
+        Bottom = std::max(Bottom, Window->Y + Window->Height);
+    }
+
+    if(Index->Targets.empty())
+        return;
+
+    // Cells of at least 128 points, at most 32 along the longest side
+    Index->CellSize = std::max(128, std::max(Right - Left, Bottom - Top) / 32 + 1);
+    Index->X = Left;
+    Index->Y = Top;
+    Index->Columns = (Right - Left) / Index->CellSize + 1;
+    Index->Rows = (Bottom - Top) / Index->CellSize + 1;
+    Index->Cells.resize(Index->Columns * Index->Rows);
 
-        if(IsWindowBelowCursor(&KWMTiling.FocusLst[WindowIndex]) && ShouldWindowGainFocus(&KWMTiling.FocusLst[WindowIndex]))
+    // Targets are visited front to back, so every cell lists its windows in z-order
+    for(std::size_t TargetIndex = 0; TargetIndex < Index->Targets.size(); ++TargetIndex)
+    {
+        window_info *Window = &KWMTiling.FocusLst[Index->Targets[TargetIndex]];
+        int FirstColumn = (Window->X - Left) / Index->CellSize;
+        int LastColumn = (Window->X + Window->Width - Left) / Index->CellSize;
+        int FirstRow = (Window->Y - Top) / Index->CellSize;
+        int LastRow = (Window->Y + Window->Height - Top) / Index->CellSize;
+
+        for(int Row = FirstRow; Row <= LastRow; ++Row)
         {
-            if(WindowsAreEqual(KWMFocus.Window, &KWMTiling.FocusLst[WindowIndex]))
-                KWMFocus.Cache = KWMTiling.FocusLst[WindowIndex];
-            else
-                SetWindowFocus(&KWMTiling.FocusLst[WindowIndex]);
+            for(int Column = FirstColumn; Column <= LastColumn; ++Column)
+                Index->Cells[Row * Index->Columns + Column].push_back(TargetIndex);
+        }
+    }
 
-            return;
+    DEBUG("UpdateWindowFocusIndex() " << Index->Targets.size() << " windows in " << Index->Columns << "x" << Index->Rows << " cells")
+}
+
+window_info *GetFocusTargetAtPoint(CGPoint Point)
+{
+    window_index *Index = &KWMCache.FocusIndex;
+    if(Index->Hit != -1 && Index->HitUnoccluded)
+    {
+        window_info *Window = &KWMTiling.FocusLst[Index->Targets[Index->Hit]];
+        if(IsPointInsideWindow(Point, Window))
+            return Window;
+    }
+
+    Index->Hit = -1;
+    if(Index->Cells.empty())
+        return NULL;
+
+    int Column = std::floor((Point.x - Index->X) / Index->CellSize);
+    int Row = std::floor((Point.y - Index->Y) / Index->CellSize);
+    if(Column < 0 || Column >= Index->Columns || Row < 0 || Row >= Index->Rows)
+        return NULL;
+
+    const std::vector<std::size_t> &Cell = Index->Cells[Row * Index->Columns + Column];
+    for(std::size_t CellIndex = 0; CellIndex < Cell.size(); ++CellIndex)
+    {
+        window_info *Window = &KWMTiling.FocusLst[Index->Targets[Cell[CellIndex]]];
+        if(!IsPointInsideWindow(Point, Window))
+            continue;
+
+        // The hit is reused while the cursor stays inside it, unless a window in front overlaps it
+        Index->Hit = Cell[CellIndex];
+        Index->HitUnoccluded = true;
+        for(int Front = 0; Front < Index->Hit && Index->HitUnoccluded; ++Front)
+        {
+            window_info *FrontWindow = &KWMTiling.FocusLst[Index->Targets[Front]];
+            Index->HitUnoccluded = FrontWindow->X > Window->X + Window->Width ||
+                                   FrontWindow->X + FrontWindow->Width < Window->X ||
+                                   FrontWindow->Y > Window->Y + Window->Height ||
+                                   FrontWindow->Y + FrontWindow->Height < Window->Y;
         }
+
+        return Window;
     }
+
+    return NULL;
 }
 
 void UpdateWindowTree()
@@ -331,12 +528,13 @@ void UpdateWindowTree()
                 ShouldWindowNodeTreeUpdate(KWMScreen.Current);
             else if(Space->Initialized && WindowsOnDisplay.empty())
             {
-                DestroyNodeTree(Space->RootNode, Space->Mode);
-                Space->RootNode = NULL;
+                DestroyNodeTree(Space);
                 ClearFocusedWindow();
             }
         }
     }
+
+    FlushTreeLayout();
 }
 
 void UpdateActiveWindowList(screen_info *Screen)
@@ -347,19 +545,25 @@ void UpdateActiveWindowList(screen_info *Screen)
     Screen->OldWindowListCount = KWMTiling.WindowLst.size();
     KWMTiling.WindowLst.clear();
 
+    // Without a window list the lists and their geometry are left empty, never out of step
     CFArrayRef OsxWindowLst = CGWindowListCopyWindowInfo(OsxWindowListOption, kCGNullWindowID);
-    if(!OsxWindowLst)
-        return;
-
-    CFIndex OsxWindowCount = CFArrayGetCount(OsxWindowLst);
-    for(CFIndex WindowIndex = 0; WindowIndex < OsxWindowCount; ++WindowIndex)
+    if(OsxWindowLst)
     {
-        CFDictionaryRef Elem = (CFDictionaryRef)CFArrayGetValueAtIndex(OsxWindowLst, WindowIndex);
-        KWMTiling.WindowLst.push_back(window_info());
-        CFDictionaryApplyFunction(Elem, GetWindowInfo, NULL);
+        CFIndex OsxWindowCount = CFArrayGetCount(OsxWindowLst);
+        for(CFIndex WindowIndex = 0; WindowIndex < OsxWindowCount; ++WindowIndex)
+        {
+            CFDictionaryRef Elem = (CFDictionaryRef)CFArrayGetValueAtIndex(OsxWindowLst, WindowIndex);
+            KWMTiling.WindowLst.push_back(window_info());
+            CFDictionaryApplyFunction(Elem, GetWindowInfo, NULL);
+        }
+        CFRelease(OsxWindowLst);
     }
-    CFRelease(OsxWindowLst);
+
     KWMTiling.FocusLst = KWMTiling.WindowLst;
+    UpdateWindowFrameCache();
+    BuildWindowGeometry(KWMTiling.WindowLst, &KWMTiling.WindowGeometry);
+    KWMTiling.FocusGeometry = KWMTiling.WindowGeometry;
+    UpdateWindowFocusIndex();
 }
 
 void CreateWindowNodeTree(screen_info *Screen, std::vector<window_info*> *Windows)
@@ -385,15 +589,11 @@ void CreateWindowNodeTree(screen_info *Screen, std::vector<window_info*> *Window
         Space->RootNode = CreateTreeFromWindowIDList(Screen, *Windows);
     }
     else if(Space->Initialized)
-    {
         Space->RootNode = CreateTreeFromWindowIDList(Screen, *Windows);
-        ResizeTreeNodes(Screen, Space->RootNode);
-        ApplyNodeContainer(Space->RootNode, Space->Mode);
-    }
 
     if(Space->RootNode)
     {
-        ApplyNodeContainer(Space->RootNode, Space->Mode);
+        ApplyNodeContainer(Space);
         FocusWindowBelowCursor();
     }
 }
@@ -404,79 +604,94 @@ void ShouldWindowNodeTreeUpdate(screen_info *Screen)
         return;
 
     space_info *Space = GetActiveSpaceOfScreen(Screen);
+    Assert(IsWindowIndexConsistent(Space), "ShouldWindowNodeTreeUpdate() WindowID index")
+
     if(Space->Mode == SpaceModeBSP)
         ShouldBSPTreeUpdate(Screen, Space);
-    else if(Space->Mode == SpaceModeMonocle)
+    else if(IsRingSpaceMode(Space->Mode))
         ShouldMonocleTreeUpdate(Screen, Space);
 }
 
-void ShouldBSPTreeUpdate(screen_info *Screen, space_info *Space)
+bool GetWindowTreeChanges(space_info *Space, std::vector<window_info*> *Added, std::vector<int> *Removed)
 {
-    if(KWMTiling.WindowLst.size() > Screen->OldWindowListCount)
+    std::size_t WindowsInTree = 0;
+    for(std::size_t WindowIndex = 0; WindowIndex < KWMTiling.WindowLst.size(); ++WindowIndex)
+    {
+        window_info *Window = &KWMTiling.WindowLst[WindowIndex];
+        if(GetNodeFromWindowID(Space, Window->WID))
+            ++WindowsInTree;
+        else if(!IsApplicationFloating(Window) && !IsWindowFloating(Window->WID, NULL))
+            Added->push_back(Window);
+    }
+
+    if(WindowsInTree < Space->WindowNodes.size())
     {
+        std::vector<int> WindowIDs;
+        WindowIDs.reserve(KWMTiling.WindowLst.size());
         for(std::size_t WindowIndex = 0; WindowIndex < KWMTiling.WindowLst.size(); ++WindowIndex)
+            WindowIDs.push_back(KWMTiling.WindowLst[WindowIndex].WID);
+
+        std::sort(WindowIDs.begin(), WindowIDs.end());
+        std::unordered_map<int, tree_node*>::iterator It;
+        for(It = Space->WindowNodes.begin(); It != Space->WindowNodes.end(); ++It)
         {
-            if(!GetNodeFromWindowID(Space->RootNode, KWMTiling.WindowLst[WindowIndex].WID, Space->Mode))
-            {
-                if(!IsApplicationFloating(&KWMTiling.WindowLst[WindowIndex]) &&
-                   !IsWindowFloating(KWMTiling.WindowLst[WindowIndex].WID, NULL))
-                {
-                    DEBUG("ShouldBSPTreeUpdate() Add Window")
-                    tree_node *Insert = GetFirstPseudoLeafNode(Space->RootNode);
-                    if(Insert)
-                    {
-                        Insert->WindowID = KWMTiling.WindowLst[WindowIndex].WID;
-                        ApplyNodeContainer(Insert, SpaceModeBSP);
-                    }
-                    else
-                    {
-                        AddWindowToBSPTree(Screen, KWMTiling.WindowLst[WindowIndex].WID);
-                    }
-
-                    SetWindowFocus(&KWMTiling.WindowLst[WindowIndex]);
-                    MoveCursorToCenterOfFocusedWindow();
-                }
-            }
+            if(!std::binary_search(WindowIDs.begin(), WindowIDs.end(), It->first))
+                Removed->push_back(It->first);
         }
     }
-    else if(KWMTiling.WindowLst.size() < Screen->OldWindowListCount)
+
+    return !Added->empty() || !Removed->empty();
+}
+
+void ShouldBSPTreeUpdate(screen_info *Screen, space_info *Space)
+{
+    std::vector<window_info*> WindowsAdded;
+    std::vector<int> WindowsRemoved;
+    if(!GetWindowTreeChanges(Space, &WindowsAdded, &WindowsRemoved))
+        return;
+
+    for(std::size_t IDIndex = 0; IDIndex < WindowsRemoved.size(); ++IDIndex)
     {
-        std::vector<int> WindowIDsInTree;
+        DEBUG("ShouldBSPTreeUpdate() Remove Window " << WindowsRemoved[IDIndex])
+        RemoveWindowFromBSPTree(Screen, WindowsRemoved[IDIndex], false);
+    }
 
-        tree_node *CurrentNode = GetFirstLeafNode(Space->RootNode);
-        while(CurrentNode)
+    for(std::size_t WindowIndex = 0; WindowIndex < WindowsAdded.size(); ++WindowIndex)
+    {
+        window_info *Window = WindowsAdded[WindowIndex];
+        DEBUG("ShouldBSPTreeUpdate() Add Window")
+        tree_node *Insert = GetFirstPseudoLeafNode(Space->RootNode);
+        if(Insert)
         {
-            WindowIDsInTree.push_back(CurrentNode->WindowID);
-            CurrentNode = GetNearestNodeToTheRight(CurrentNode, SpaceModeBSP);
+            SetNodeWindowID(Space, Insert, Window->WID);
+            MarkNodeDirty(Insert);
         }
-
-        for(std::size_t IDIndex = 0; IDIndex < WindowIDsInTree.size(); ++IDIndex)
+        else
         {
-            bool Found = false;
-            for(std::size_t WindowIndex = 0; WindowIndex < KWMTiling.WindowLst.size(); ++WindowIndex)
-            {
-                if(KWMTiling.WindowLst[WindowIndex].WID == WindowIDsInTree[IDIndex])
-                {
-                    Found = true;
-                    break;
-                }
-            }
-
-            if(!Found)
-            {
-                DEBUG("ShouldBSPTreeUpdate() Remove Window " << WindowIDsInTree[IDIndex])
-                RemoveWindowFromBSPTree(Screen, WindowIDsInTree[IDIndex], true);
-            }
+            AddWindowToBSPTree(Screen, Window->WID);
         }
 
-        if(!KWMFocus.Window)
-        {
-            ClearFocusedWindow();
-            if(IsAnyWindowBelowCursor() && KWMMode.Focus != FocusModeDisabled)
-                FocusWindowBelowCursor();
-            else if(FocusWindowOfOSX())
-                MoveCursorToCenterOfFocusedWindow();
-        }
+        // The next window splits the container of this one
+        SetWindowFocus(Window);
+    }
+
+    if(!WindowsAdded.empty())
+    {
+        MoveCursorToCenterOfFocusedWindow();
+    }
+    else if(!WindowsRemoved.empty())
+    {
+        SetWindowFocusByNode(GetFirstLeafNode(Space->RootNode));
+        MoveCursorToCenterOfFocusedWindow();
+    }
+
+    if(!WindowsRemoved.empty() && !KWMFocus.Window)
+    {
+        ClearFocusedWindow();
+        if(IsAnyWindowBelowCursor() && KWMMode.Focus != FocusModeDisabled)
+            FocusWindowBelowCursor();
+        else if(FocusWindowOfOSX())
+            MoveCursorToCenterOfFocusedWindow();
     }
 }
 
@@ -499,7 +714,7 @@ void AddWindowToBSPTree(screen_info *Screen, int WindowID)
 
     if(KWMScreen.MarkedWindow == -1 && UseFocusedContainer)
     {
-        CurrentNode = GetNodeFromWindowID(RootNode, KWMFocus.Window->WID, Space->Mode);
+        CurrentNode = GetNodeFromWindowID(Space, KWMFocus.Window->WID);
     }
     else if(DoNotUseMarkedContainer || (KWMScreen.MarkedWindow == -1 && !UseFocusedContainer))
     {
@@ -508,7 +723,7 @@ void AddWindowToBSPTree(screen_info *Screen, int WindowID)
     }
     else
     {
-        CurrentNode = GetNodeFromWindowID(RootNode, KWMScreen.MarkedWindow, Space->Mode);
+        CurrentNode = GetNodeFromWindowID(Space, KWMScreen.MarkedWindow);
         ClearMarkedWindow();
     }
     AddElementToTree(Screen, CurrentNode, WindowID, KWMScreen.SplitMode, SpaceModeBSP);
@@ -528,7 +743,7 @@ void RemoveWindowFromBSPTree(screen_info *Screen, int WindowID, bool Refresh)
         return;
 
     space_info *Space = GetActiveSpaceOfScreen(Screen);
-    RemoveElementFromTree(Screen, Space->RootNode, WindowID, Space->Mode);
+    RemoveElementFromTree(Screen, WindowID, Space->Mode);
 
     if(Refresh)
     {
@@ -547,61 +762,32 @@ void RemoveWindowFromBSPTree()
 
 void ShouldMonocleTreeUpdate(screen_info *Screen, space_info *Space)
 {
-    if(KWMTiling.WindowLst.size() > Screen->OldWindowListCount)
+    std::vector<window_info*> WindowsAdded;
+    std::vector<int> WindowsRemoved;
+    if(!GetWindowTreeChanges(Space, &WindowsAdded, &WindowsRemoved))
+        return;
+
+    for(std::size_t IDIndex = 0; IDIndex < WindowsRemoved.size(); ++IDIndex)
     {
-        DEBUG("ShouldMonocleTreeUpdate() Add Window")
-        for(std::size_t WindowIndex = 0; WindowIndex < KWMTiling.WindowLst.size(); ++WindowIndex)
-        {
-            if(!GetNodeFromWindowID(Space->RootNode, KWMTiling.WindowLst[WindowIndex].WID, Space->Mode))
-            {
-                if(!IsApplicationFloating(&KWMTiling.WindowLst[WindowIndex]))
-                {
-                    AddWindowToMonocleTree(Screen, KWMTiling.WindowLst[WindowIndex].WID);
-                    SetWindowFocus(&KWMTiling.WindowLst[WindowIndex]);
-                    MoveCursorToCenterOfFocusedWindow();
-                }
-            }
-        }
+        DEBUG("ShouldMonocleTreeUpdate() Remove Window " << WindowsRemoved[IDIndex])
+        RemoveElementFromTree(Screen, WindowsRemoved[IDIndex], Space->Mode);
     }
-    else if(KWMTiling.WindowLst.size() < Screen->OldWindowListCount)
-    {
-        DEBUG("ShouldMonocleTreeUpdate() Remove Window")
-        std::vector<int> WindowIDsInTree;
 
-        tree_node *CurrentNode = Space->RootNode;
-        while(CurrentNode)
-        {
-            WindowIDsInTree.push_back(CurrentNode->WindowID);
-            CurrentNode = GetNearestNodeToTheRight(CurrentNode, SpaceModeMonocle);
-        }
-
-        if(WindowIDsInTree.size() >= 2)
-        {
-            for(std::size_t IDIndex = 0; IDIndex < WindowIDsInTree.size(); ++IDIndex)
-            {
-                bool Found = false;
-                for(std::size_t WindowIndex = 0; WindowIndex < KWMTiling.WindowLst.size(); ++WindowIndex)
-                {
-                    if(KWMTiling.WindowLst[WindowIndex].WID == WindowIDsInTree[IDIndex])
-                    {
-                        Found = true;
-                        break;
-                    }
-                }
-
-                if(!Found)
-                    RemoveWindowFromMonocleTree(Screen, WindowIDsInTree[IDIndex]);
-            }
-        }
-        else
-        {
-            tree_node *WindowNode = GetNodeFromWindowID(Space->RootNode, WindowIDsInTree[0], SpaceModeMonocle);
-            if(!WindowNode)
-                return;
+    for(std::size_t WindowIndex = 0; WindowIndex < WindowsAdded.size(); ++WindowIndex)
+    {
+        DEBUG("ShouldMonocleTreeUpdate() Add Window")
+        AddWindowToMonocleTree(Screen, WindowsAdded[WindowIndex]->WID);
+    }
 
-            free(WindowNode);
-            Space->RootNode = NULL;
-        }
+    if(!WindowsAdded.empty())
+    {
+        SetWindowFocus(WindowsAdded.back());
+        MoveCursorToCenterOfFocusedWindow();
+    }
+    else if(!WindowsRemoved.empty() && Space->RootNode)
+    {
+        SetWindowFocusByNode(GetFirstLeafNode(Space->RootNode));
+        MoveCursorToCenterOfFocusedWindow();
     }
 }
 
@@ -611,14 +797,7 @@ void AddWindowToMonocleTree(screen_info *Screen, int WindowID)
         return;
 
     space_info *Space = GetActiveSpaceOfScreen(Screen);
-    tree_node *CurrentNode = GetLastLeafNode(Space->RootNode);
-    tree_node *NewNode = CreateRootNode(Screen);
-
-    NewNode->WindowID = WindowID;
-    CurrentNode->RightChild = NewNode;
-    NewNode->LeftChild = CurrentNode;
-
-    ApplyNodeContainer(NewNode, SpaceModeMonocle);
+    AddElementToTree(Screen, GetLastLeafNode(Space), WindowID, KWMScreen.SplitMode, Space->Mode);
 }
 
 void RemoveWindowFromMonocleTree(screen_info *Screen, int WindowID)
@@ -627,7 +806,7 @@ void RemoveWindowFromMonocleTree(screen_info *Screen, int WindowID)
         return;
 
     space_info *Space = GetActiveSpaceOfScreen(Screen);
-    RemoveElementFromTree(Screen, Space->RootNode, WindowID, Space->Mode);
+    RemoveElementFromTree(Screen, WindowID, Space->Mode);
 
     SetWindowFocusByNode(GetFirstLeafNode(Space->RootNode));
     MoveCursorToCenterOfFocusedWindow();
@@ -644,7 +823,6 @@ void AddWindowToTreeOfUnfocusedMonitor(screen_info *Screen, window_info *Window)
     if(!IsSpaceInitializedForScreen(Screen))
     {
         CenterWindow(Screen, Window);
-        Screen->ForceContainerUpdate = true;
         return;
     }
 
@@ -656,19 +834,17 @@ void AddWindowToTreeOfUnfocusedMonitor(screen_info *Screen, window_info *Window)
         {
             DEBUG("AddWindowToTreeOfUnfocusedMonitor() BSP Space")
             CurrentNode = LevelOrderSearch(IsLeafNode, Space->RootNode);
-            Screen->ForceContainerUpdate = true;
         }
-        else if(Space->Mode == SpaceModeMonocle)
+        else if(IsRingSpaceMode(Space->Mode))
         {
-            DEBUG("AddWindowToTreeOfUnfocusedMonitor() Monocle Space")
-            CurrentNode = GetLastLeafNode(Space->RootNode);
+            DEBUG("AddWindowToTreeOfUnfocusedMonitor() Monocle, Master or Grid Space")
+            CurrentNode = GetLastLeafNode(Space);
         }
         AddElementToTree(Screen, CurrentNode, Window->WID, KWMScreen.SplitMode, Space->Mode);
     }
     else
     {
         CenterWindow(Screen, Window);
-        Screen->ForceContainerUpdate = true;
     }
 }
 
@@ -712,7 +888,7 @@ void ToggleFocusedWindowParentContainer()
     if(Space->Mode != SpaceModeBSP)
         return;
 
-    tree_node *Node = GetNodeFromWindowID(Space->RootNode, KWMFocus.Window->WID, Space->Mode);
+    tree_node *Node = GetNodeFromWindowID(Space, KWMFocus.Window->WID);
     if(Node && Node->Parent)
     {
         if(IsLeafNode(Node) && Node->Parent->WindowID == -1)
@@ -743,7 +919,7 @@ void ToggleFocusedWindowFullscreen()
         tree_node *Node = NULL;
         if(Space->RootNode->WindowID == -1)
         {
-            Node = GetNodeFromWindowID(Space->RootNode, KWMFocus.Window->WID, Space->Mode);
+            Node = GetNodeFromWindowID(Space, KWMFocus.Window->WID);
             if(Node)
             {
                 DEBUG("ToggleFocusedWindowFullscreen() Set fullscreen")
@@ -757,7 +933,7 @@ void ToggleFocusedWindowFullscreen()
             DEBUG("ToggleFocusedWindowFullscreen() Restore old size")
             Space->RootNode->WindowID = -1;
 
-            Node = GetNodeFromWindowID(Space->RootNode, KWMFocus.Window->WID, Space->Mode);
+            Node = GetNodeFromWindowID(Space, KWMFocus.Window->WID);
             if(Node)
             {
                 ResizeWindowToContainerSize(Node);
@@ -775,6 +951,7 @@ void DetachAndReinsertWindow(int WindowID, int Degrees)
         if(Marked == -1 || (KWMFocus.Window && Marked == KWMFocus.Window->WID))
             return;
 
+        RecordTreeLayout(GetActiveSpaceOfScreen(KWMScreen.Current));
         ToggleWindowFloating(Marked);
         ClearMarkedWindow();
         ToggleWindowFloating(Marked);
@@ -789,6 +966,7 @@ void DetachAndReinsertWindow(int WindowID, int Degrees)
         window_info InsertWindow = {};
         if(FindClosestWindow(Degrees, &InsertWindow, false))
         {
+            RecordTreeLayout(GetActiveSpaceOfScreen(KWMScreen.Current));
             ToggleWindowFloating(WindowID);
             KWMScreen.MarkedWindow = InsertWindow.WID;
             ToggleWindowFloating(WindowID);
@@ -805,13 +983,14 @@ void SwapFocusedWindowWithMarked()
     if(DoesSpaceExistInMapOfScreen(KWMScreen.Current))
     {
         space_info *Space = GetActiveSpaceOfScreen(KWMScreen.Current);
-        tree_node *FocusedWindowNode = GetNodeFromWindowID(Space->RootNode, KWMFocus.Window->WID, Space->Mode);
+        tree_node *FocusedWindowNode = GetNodeFromWindowID(Space, KWMFocus.Window->WID);
         if(FocusedWindowNode)
         {
-            tree_node *NewFocusNode = GetNodeFromWindowID(Space->RootNode, KWMScreen.MarkedWindow, Space->Mode);
+            tree_node *NewFocusNode = GetNodeFromWindowID(Space, KWMScreen.MarkedWindow);
             if(NewFocusNode)
             {
-                SwapNodeWindowIDs(FocusedWindowNode, NewFocusNode);
+                RecordTreeLayout(Space);
+                SwapNodeWindowIDs(Space, FocusedWindowNode, NewFocusNode);
                 MoveCursorToCenterOfFocusedWindow();
             }
         }
@@ -826,19 +1005,20 @@ void SwapFocusedWindowWithNearest(int Shift)
         return;
 
     space_info *Space = GetActiveSpaceOfScreen(KWMScreen.Current);
-    tree_node *FocusedWindowNode = GetNodeFromWindowID(Space->RootNode, KWMFocus.Window->WID, Space->Mode);
+    tree_node *FocusedWindowNode = GetNodeFromWindowID(Space, KWMFocus.Window->WID);
     if(FocusedWindowNode)
     {
         tree_node *NewFocusNode = NULL;;
 
         if(Shift == 1)
-            NewFocusNode = GetNearestNodeToTheRight(FocusedWindowNode, Space->Mode);
+            NewFocusNode = GetNearestNodeToTheRight(Space, FocusedWindowNode);
         else if(Shift == -1)
-            NewFocusNode = GetNearestNodeToTheLeft(FocusedWindowNode, Space->Mode);
+            NewFocusNode = GetNearestNodeToTheLeft(Space, FocusedWindowNode);
 
         if(NewFocusNode)
         {
-            SwapNodeWindowIDs(FocusedWindowNode, NewFocusNode);
+            RecordTreeLayout(Space);
+            SwapNodeWindowIDs(Space, FocusedWindowNode, NewFocusNode);
             MoveCursorToCenterOfFocusedWindow();
 
             if(FocusedWindowNode->WindowID == KWMScreen.MarkedWindow ||
@@ -854,27 +1034,30 @@ void SwapFocusedWindowDirected(int Degrees)
         return;
 
     space_info *Space = GetActiveSpaceOfScreen(KWMScreen.Current);
-    tree_node *FocusedWindowNode = GetNodeFromWindowID(Space->RootNode, KWMFocus.Window->WID, Space->Mode);
+    tree_node *FocusedWindowNode = GetNodeFromWindowID(Space, KWMFocus.Window->WID);
     if(FocusedWindowNode)
     {
         tree_node *NewFocusNode = NULL;
-        if(Space->Mode == SpaceModeBSP)
+        if(Space->Mode == SpaceModeBSP ||
+           Space->Mode == SpaceModeMaster ||
+           Space->Mode == SpaceModeGrid)
         {
             window_info SwapWindow = {};
             if(FindClosestWindow(Degrees, &SwapWindow, KWMMode.Cycle == CycleModeScreen))
-                NewFocusNode = GetNodeFromWindowID(Space->RootNode, SwapWindow.WID, Space->Mode);
+                NewFocusNode = GetNodeFromWindowID(Space, SwapWindow.WID);
         }
         else if(Space->Mode == SpaceModeMonocle)
         {
             if(Degrees == 90)
-                NewFocusNode = GetNearestNodeToTheRight(FocusedWindowNode, Space->Mode);
+                NewFocusNode = GetNearestNodeToTheRight(Space, FocusedWindowNode);
             else if(Degrees == 270)
-                NewFocusNode = GetNearestNodeToTheLeft(FocusedWindowNode, Space->Mode);
+                NewFocusNode = GetNearestNodeToTheLeft(Space, FocusedWindowNode);
         }
 
         if(NewFocusNode)
         {
-            SwapNodeWindowIDs(FocusedWindowNode, NewFocusNode);
+            RecordTreeLayout(Space);
+            SwapNodeWindowIDs(Space, FocusedWindowNode, NewFocusNode);
             MoveCursorToCenterOfFocusedWindow();
 
             if(FocusedWindowNode->WindowID == KWMScreen.MarkedWindow ||
@@ -937,47 +1120,59 @@ bool FindClosestWindow(int Degrees, window_info *Target, bool Wrap)
 {
     *Target = KWMFocus.Cache;
     window_info *Match = KWMFocus.Window;
-    std::vector<window_info> Windows = KWMTiling.WindowLst;
-
-    int MatchX, MatchY;
-    GetCenterOfWindow(Match, &MatchX, &MatchY);
-
     double MinDist = INT_MAX;
-    for(int Index = 0; Index < Windows.size(); ++Index)
+    bool Found = false;
+
+    // A tiled window takes its tiled neighbour from the table of its space, and
+    // only the windows outside the tree are scored when the space has any
+    space_info *Space = NULL;
+    if(DoesSpaceExistInMapOfScreen(KWMScreen.Current))
     {
-        if(!WindowsAreEqual(Match, &Windows[Index]) &&
-           WindowIsInDirection(Match, &Windows[Index], Degrees, Wrap))
+        Space = GetActiveSpaceOfScreen(KWMScreen.Current);
+        tree_node *Node = GetNodeFromWindowID(Space, Match->WID);
+        if(Node)
         {
-            window_info FocusWindow = Windows[Index];
-
-            if(Wrap)
+            tree_node *Neighbour = GetNodeNeighbour(KWMScreen.Current, Space, Node, Degrees, Wrap);
+            window_info *Window = Neighbour ? GetWindowByID(Neighbour->WindowID) : NULL;
+            if(Window)
             {
-                int WindowX, WindowY;
-                GetCenterOfWindow(&Windows[Index], &WindowX, &WindowY);
-
-                window_info WrappedWindow = Windows[Index];
-                if(Degrees == 0 && MatchY < WindowY)
-                    WrappedWindow.Y -= KWMScreen.Current->Height;
-                else if(Degrees == 180 && MatchY > WindowY)
-                    WrappedWindow.Y += KWMScreen.Current->Height;
-                else if(Degrees == 90 && MatchX > WindowX)
-                    WrappedWindow.X += KWMScreen.Current->Width;
-                else if(Degrees == 270 && MatchX < WindowX)
-                    WrappedWindow.X -= KWMScreen.Current->Width;
-
-                FocusWindow = WrappedWindow;
+                *Target = *Window;
+                MinDist = GetDirectedRectDistance(*Match, Window->X, Window->Y, Window->Width, Window->Height,
+                                                  Degrees, Wrap, KWMScreen.Current->Width, KWMScreen.Current->Height);
+                Found = true;
             }
 
-            double Dist = GetWindowDistance(Match, &FocusWindow);
-            if(Dist < MinDist)
-            {
-                MinDist = Dist;
-                *Target = Windows[Index];
-            }
+            if(KWMTiling.WindowLst.size() <= Space->WindowNodes.size())
+                return Found;
+        }
+        else
+        {
+            Space = NULL;
         }
     }
 
-    return MinDist != INT_MAX;
+    Assert(KWMTiling.WindowGeometry.X.size() == KWMTiling.WindowLst.size(), "FindClosestWindow()")
+
+    // GetDirectedRectDistances() writes one distance per rectangle of the geometry
+    std::vector<double> Distances(KWMTiling.WindowGeometry.X.size());
+    GetDirectedRectDistances(KWMTiling.WindowGeometry, *Match, Degrees, Wrap,
+                             KWMScreen.Current->Width, KWMScreen.Current->Height, Distances.data());
+
+    std::size_t Count = std::min(Distances.size(), KWMTiling.WindowLst.size());
+    for(std::size_t Index = 0; Index < Count; ++Index)
+    {
+        if(Space && GetNodeFromWindowID(Space, KWMTiling.WindowLst[Index].WID))
+            continue;
+
+        if(Distances[Index] < MinDist && !WindowsAreEqual(Match, &KWMTiling.WindowLst[Index]))
+        {
+            MinDist = Distances[Index];
+            *Target = KWMTiling.WindowLst[Index];
+            Found = true;
+        }
+    }
+
+    return Found;
 }
 
 void ShiftWindowFocusDirected(int Degrees)
@@ -987,7 +1182,9 @@ void ShiftWindowFocusDirected(int Degrees)
         return;
 
     space_info *Space = GetActiveSpaceOfScreen(KWMScreen.Current);
-    if(Space->Mode == SpaceModeBSP)
+    if(Space->Mode == SpaceModeBSP ||
+       Space->Mode == SpaceModeMaster ||
+       Space->Mode == SpaceModeGrid)
     {
         window_info NewFocusWindow = {};
         if((KWMMode.Cycle == CycleModeDisabled &&
@@ -1017,8 +1214,7 @@ void ShiftWindowFocusDirected(int Degrees)
                 {
                     screen_info *Screen = GetDisplayFromScreenID(ScreenIndex);
                     space_info *Space = GetActiveSpaceOfScreen(Screen);
-                    tree_node *RootNode = Space->RootNode;
-                    tree_node *FocusNode = Degrees == 90 ? GetFirstLeafNode(RootNode) : GetLastLeafNode(RootNode);
+                    tree_node *FocusNode = Degrees == 90 ? GetFirstLeafNode(Space) : GetLastLeafNode(Space);
                     if(FocusNode)
                         GiveFocusToScreen(ScreenIndex, FocusNode, false);
                 }
@@ -1040,24 +1236,24 @@ void ShiftWindowFocus(int Shift)
         return;
 
     space_info *Space = GetActiveSpaceOfScreen(KWMScreen.Current);
-    tree_node *FocusedWindowNode = GetNodeFromWindowID(Space->RootNode, KWMFocus.Window->WID, Space->Mode);
+    tree_node *FocusedWindowNode = GetNodeFromWindowID(Space, KWMFocus.Window->WID);
     if(FocusedWindowNode)
     {
         tree_node *FocusNode = NULL;
 
         if(Shift == 1)
         {
-            FocusNode = GetNearestNodeToTheRight(FocusedWindowNode, Space->Mode);
+            FocusNode = GetNearestNodeToTheRight(Space, FocusedWindowNode);
             if(KWMMode.Cycle == CycleModeScreen && !FocusNode)
             {
-                FocusNode = GetFirstLeafNode(Space->RootNode);
+                FocusNode = GetFirstLeafNode(Space);
             }
             else if(KWMMode.Cycle == CycleModeAll && !FocusNode)
             {
                 int ScreenIndex = GetIndexOfNextScreen();
                 screen_info *Screen = GetDisplayFromScreenID(ScreenIndex);
                 space_info *Space = GetActiveSpaceOfScreen(Screen);
-                FocusNode = GetFirstLeafNode(Space->RootNode);
+                FocusNode = GetFirstLeafNode(Space);
                 if(FocusNode)
                 {
                     GiveFocusToScreen(ScreenIndex, FocusNode, false);
@@ -1067,17 +1263,17 @@ void ShiftWindowFocus(int Shift)
         }
         else if(Shift == -1)
         {
-            FocusNode = GetNearestNodeToTheLeft(FocusedWindowNode, Space->Mode);
+            FocusNode = GetNearestNodeToTheLeft(Space, FocusedWindowNode);
             if(KWMMode.Cycle == CycleModeScreen && !FocusNode)
             {
-                FocusNode = GetLastLeafNode(Space->RootNode);
+                FocusNode = GetLastLeafNode(Space);
             }
             else if(KWMMode.Cycle == CycleModeAll && !FocusNode)
             {
                 int ScreenIndex = GetIndexOfPrevScreen();
                 screen_info *Screen = GetDisplayFromScreenID(ScreenIndex);
                 space_info *Space = GetActiveSpaceOfScreen(Screen);
-                FocusNode = GetLastLeafNode(Space->RootNode);
+                FocusNode = GetLastLeafNode(Space);
                 if(FocusNode)
                 {
                     GiveFocusToScreen(ScreenIndex, FocusNode, false);
@@ -1107,7 +1303,7 @@ void FocusWindowByID(int WindowID)
         {
             space_info *Space = GetActiveSpaceOfScreen(Screen);
             tree_node *Root = Space->RootNode;
-            tree_node *Node = GetNodeFromWindowID(Root, WindowID, Space->Mode);
+            tree_node *Node = GetNodeFromWindowID(Space, WindowID);
             if(Node)
                 GiveFocusToScreen(Screen->ID, Node, false);
         }
@@ -1117,6 +1313,8 @@ void FocusWindowByID(int WindowID)
 void MoveCursorToCenterOfWindow(window_info *Window)
 {
     Assert(Window, "MoveCursorToCenterOfWindow()")
+    FlushTreeLayout();
+
     AXUIElementRef WindowRef;
     if(GetWindowRef(Window, &WindowRef))
     {
@@ -1171,6 +1369,15 @@ void SetWindowRefFocus(AXUIElementRef WindowRef, window_info *Window, bool Notif
     KWMFocus.PSN = NewPSN;
     KWMFocus.Cache = *Window;
     KWMFocus.Window = &KWMFocus.Cache;
+    KWMFocus.DwellWindowID = -1;
+
+    if(KWMToggles.EnableTilingMode)
+    {
+        space_info *Space = GetActiveSpaceOfScreen(KWMScreen.Current);
+        Space->FocusedNode = GetNodeFromWindowID(Space, Window->WID);
+        if(Space->Mode == SpaceModeMonocle)
+            ApplyPendingNodeContainer(Space->FocusedNode);
+    }
 
     AXUIElementSetAttributeValue(WindowRef, kAXMainAttribute, kCFBooleanTrue);
     AXUIElementSetAttributeValue(WindowRef, kAXFocusedAttribute, kCFBooleanTrue);
@@ -1191,12 +1398,6 @@ void SetWindowRefFocus(AXUIElementRef WindowRef, window_info *Window, bool Notif
             UpdateBorder("focused");
     }
 
-    if(KWMToggles.EnableTilingMode)
-    {
-        space_info *Space = GetActiveSpaceOfScreen(KWMScreen.Current);
-        Space->FocusedNode = GetNodeFromWindowID(Space->RootNode, Window->WID, Space->Mode);
-    }
-
     DEBUG("SetWindowRefFocus() Focused Window: " << KWMFocus.Window->Name << " " << KWMFocus.Window->X << "," << KWMFocus.Window->Y)
     if(KWMMode.Focus != FocusModeDisabled &&
        KWMMode.Focus != FocusModeAutofocus &&
@@ -1239,16 +1440,22 @@ bool IsWindowNonResizable(AXUIElementRef WindowRef, window_info *Window, CFTypeR
         SizeError = AXUIElementSetAttributeValue(WindowRef, kAXSizeAttribute, NewWindowSize);
     }
 
-    if(PosError != kAXErrorSuccess || SizeError != kAXErrorSuccess)
+    window_constraint *Constraint = GetWindowConstraint(Window);
+    Constraint->Probed = true;
+    Constraint->Resizable = PosError == kAXErrorSuccess && SizeError == kAXErrorSuccess;
+
+    if(!Constraint->Resizable)
     {
-        KWMTiling.FloatingWindowLst.push_back(Window->WID);
+        if(!IsWindowFloating(Window->WID, NULL))
+            KWMTiling.FloatingWindowLst.push_back(Window->WID);
+
         screen_info *Screen = GetDisplayOfWindow(Window);
         if(DoesSpaceExistInMapOfScreen(Screen))
         {
             space_info *Space = GetActiveSpaceOfScreen(Screen);
             if(Space->Mode == SpaceModeBSP)
                 RemoveWindowFromBSPTree(Screen, Window->WID, false);
-            else if(Space->Mode == SpaceModeMonocle)
+            else if(IsRingSpaceMode(Space->Mode))
                 RemoveWindowFromMonocleTree(Screen, Window->WID);
         }
 
@@ -1258,12 +1465,14 @@ bool IsWindowNonResizable(AXUIElementRef WindowRef, window_info *Window, CFTypeR
     return false;
 }
 
-void CenterWindowInsideNodeContainer(AXUIElementRef WindowRef, int *Xptr, int *Yptr, int *Wptr, int *Hptr)
+void CenterWindowInsideNodeContainer(AXUIElementRef WindowRef, window_info *Window, int *Xptr, int *Yptr, int *Wptr, int *Hptr)
 {
     CGPoint WindowOrigin = GetWindowPos(WindowRef);
     CGSize WindowOGSize = GetWindowSize(WindowRef);
 
     int &X = *Xptr, &Y = *Yptr, &Width = *Wptr, &Height = *Hptr;
+    LearnWindowConstraint(Window, Width, Height, WindowOGSize.width, WindowOGSize.height);
+
     int XDiff = (X + Width) - (WindowOrigin.x + WindowOGSize.width);
     int YDiff = (Y + Height) - (WindowOrigin.y + WindowOGSize.height);
 
@@ -1313,19 +1522,19 @@ void SetWindowDimensions(AXUIElementRef WindowRef, window_info *Window, int X, i
 
     DEBUG("SetWindowDimensions()")
     bool UpdateWindowInfo = true;
-    if(KWMTiling.FloatNonResizable)
+    if(KWMTiling.FloatNonResizable && !IsWindowResizable(Window))
     {
         if(IsWindowNonResizable(WindowRef, Window, NewWindowPos, NewWindowSize))
             UpdateWindowInfo = false;
         else
-            CenterWindowInsideNodeContainer(WindowRef, &X, &Y, &Width, &Height);
+            CenterWindowInsideNodeContainer(WindowRef, Window, &X, &Y, &Width, &Height);
 
     }
     else
     {
         AXUIElementSetAttributeValue(WindowRef, kAXPositionAttribute, NewWindowPos);
         AXUIElementSetAttributeValue(WindowRef, kAXSizeAttribute, NewWindowSize);
-        CenterWindowInsideNodeContainer(WindowRef, &X, &Y, &Width, &Height);
+        CenterWindowInsideNodeContainer(WindowRef, Window, &X, &Y, &Width, &Height);
     }
 
     if(UpdateWindowInfo)
@@ -1377,21 +1586,197 @@ void MoveFloatingWindow(int X, int Y)
     }
 }
 
+bool IsWindowFrameApplied(window_info *Window, const window_frame &Target)
+{
+    std::unordered_map<int, applied_frame>::iterator It = KWMCache.WindowFrames.find(Window->WID);
+    if(It == KWMCache.WindowFrames.end())
+        return false;
+
+    const window_frame &Applied = It->second.Target;
+    const window_frame &Reported = It->second.Reported;
+    if(Applied.X != Target.X || Applied.Y != Target.Y ||
+       Applied.Width != Target.Width || Applied.Height != Target.Height)
+        return false;
+
+    // Asked for this frame since the last window list, nothing to compare against yet
+    if(It->second.ReportPending)
+        return true;
+
+    return Reported.X == Window->X && Reported.Y == Window->Y &&
+           Reported.Width == Window->Width && Reported.Height == Window->Height;
+}
+
+void CacheWindowFrame(window_info *Window, const window_frame &Target)
+{
+    // Window holds the frame kwm asked for, the next window list holds the one the window took
+    applied_frame &Frame = KWMCache.WindowFrames[Window->WID];
+    Frame.Target = Target;
+    Frame.ReportPending = true;
+}
+
+void UpdateWindowFrameCache()
+{
+    if(KWMCache.WindowFrames.empty())
+        return;
+
+    for(std::size_t WindowIndex = 0; WindowIndex < KWMTiling.WindowLst.size(); ++WindowIndex)
+    {
+        const window_info &Window = KWMTiling.WindowLst[WindowIndex];
+        std::unordered_map<int, applied_frame>::iterator It = KWMCache.WindowFrames.find(Window.WID);
+        if(It == KWMCache.WindowFrames.end() || !It->second.ReportPending)
+            continue;
+
+        It->second.Reported.X = Window.X;
+        It->second.Reported.Y = Window.Y;
+        It->second.Reported.Width = Window.Width;
+        It->second.Reported.Height = Window.Height;
+        It->second.ReportPending = false;
+    }
+}
+
+void ClearWindowFrameCache(int WindowID)
+{
+    KWMCache.WindowFrames.erase(WindowID);
+}
+
+void ClearWindowFrameCache()
+{
+    KWMCache.WindowFrames.clear();
+}
+
+window_constraint *GetWindowConstraint(window_info *Window)
+{
+    std::unordered_map<int, window_constraint>::iterator It = KWMCache.WindowConstraints.find(Window->WID);
+    if(It != KWMCache.WindowConstraints.end())
+        return &It->second;
+
+    // A new window starts with the minimum size last seen for its application
+    window_constraint Constraint = {};
+    std::map<std::string, window_constraint>::iterator App = KWMCache.AppConstraints.find(Window->Owner);
+    if(App != KWMCache.AppConstraints.end())
+    {
+        Constraint.MinWidth = App->second.MinWidth;
+        Constraint.MinHeight = App->second.MinHeight;
+    }
+
+    window_constraint &Result = KWMCache.WindowConstraints[Window->WID];
+    Result = Constraint;
+    return &Result;
+}
+
+void ClearWindowConstraint(int WindowID)
+{
+    KWMCache.WindowConstraints.erase(WindowID);
+}
+
+void UpdateWindowConstraint(int *Min, int *Max, int *Refused, int Requested, int Reported)
+{
+    if(Reported > Requested)
+    {
+        *Min = Reported;
+        if(*Max != 0 && *Max < Reported)
+            *Max = 0;
+    }
+    else if(Reported < Requested)
+    {
+        *Max = Reported;
+        *Refused = Requested;
+        if(*Min > Reported)
+            *Min = Reported;
+    }
+    else
+    {
+        if(*Min > Requested)
+            *Min = Requested;
+
+        if(*Max != 0 && *Max < Requested)
+            *Max = 0;
+    }
+}
+
+void LearnWindowConstraint(window_info *Window, int Width, int Height, int ReportedWidth, int ReportedHeight)
+{
+    window_constraint *Constraint = GetWindowConstraint(Window);
+    UpdateWindowConstraint(&Constraint->MinWidth, &Constraint->MaxWidth, &Constraint->RefusedWidth, Width, ReportedWidth);
+    UpdateWindowConstraint(&Constraint->MinHeight, &Constraint->MaxHeight, &Constraint->RefusedHeight, Height, ReportedHeight);
+
+    window_constraint &App = KWMCache.AppConstraints[Window->Owner];
+    App.MinWidth = Constraint->MinWidth;
+    App.MinHeight = Constraint->MinHeight;
+}
+
+bool IsWindowResizable(window_info *Window)
+{
+    std::unordered_map<int, window_constraint>::iterator It = KWMCache.WindowConstraints.find(Window->WID);
+    return It != KWMCache.WindowConstraints.end() && It->second.Probed && It->second.Resizable;
+}
+
+void ApplyWindowConstraint(window_info *Window, window_frame *Target)
+{
+    std::unordered_map<int, window_constraint>::iterator It = KWMCache.WindowConstraints.find(Window->WID);
+    if(It == KWMCache.WindowConstraints.end())
+        return;
+
+    // Center a window that can not grow to its container instead of correcting it afterwards.
+    // A container larger than the size the window refused probes the window again.
+    const window_constraint &Constraint = It->second;
+    if(Constraint.MaxWidth > 0 && Target->Width > Constraint.MaxWidth &&
+       Target->Width <= Constraint.RefusedWidth)
+    {
+        Target->X += (Target->Width - Constraint.MaxWidth) / 2;
+        Target->Width = Constraint.MaxWidth;
+    }
+
+    if(Constraint.MaxHeight > 0 && Target->Height > Constraint.MaxHeight &&
+       Target->Height <= Constraint.RefusedHeight)
+    {
+        Target->Y += (Target->Height - Constraint.MaxHeight) / 2;
+        Target->Height = Constraint.MaxHeight;
+    }
+}
+
 void ResizeWindowToContainerSize(tree_node *Node)
 {
     window_info *Window = GetWindowByID(Node->WindowID);
 
     if(Window)
     {
+        window_frame Target = { (int)Node->Container.X, (int)Node->Container.Y,
+                                (int)Node->Container.Width, (int)Node->Container.Height };
+        ApplyWindowConstraint(Window, &Target);
+        if(IsWindowFrameApplied(Window, Target))
+        {
+            ++KWMCache.ResizesSkipped;
+            return;
+        }
+
         AXUIElementRef WindowRef;
         if(GetWindowRef(Window, &WindowRef))
         {
+            ++KWMCache.ResizesIssued;
+            window_constraint Learned = *GetWindowConstraint(Window);
             SetWindowDimensions(WindowRef, Window,
-                        Node->Container.X, Node->Container.Y,
-                        Node->Container.Width, Node->Container.Height);
+                        Target.X, Target.Y,
+                        Target.Width, Target.Height);
 
             if(WindowsAreEqual(Window, KWMFocus.Window))
                 KWMFocus.Cache = *Window;
+
+            // A window found to be non-resizable left the tree, its constraint went with Node
+            std::unordered_map<int, window_constraint>::iterator It = KWMCache.WindowConstraints.find(Window->WID);
+            if(It == KWMCache.WindowConstraints.end())
+                return;
+
+            CacheWindowFrame(Window, Target);
+
+            // A larger minimum size moves the split of the parent on the next flush
+            const window_constraint &Constraint = It->second;
+            if(Node->Parent &&
+               (Constraint.MinWidth > Learned.MinWidth || Constraint.MinHeight > Learned.MinHeight))
+            {
+                DEBUG("ResizeWindowToContainerSize() " << Window->Name << " needs " << Constraint.MinWidth << "x" << Constraint.MinHeight)
+                MarkNodeDirty(Node->Parent);
+            }
         }
     }
 }
@@ -1402,7 +1787,7 @@ void ResizeWindowToContainerSize(window_info *Window)
     if(DoesSpaceExistInMapOfScreen(KWMScreen.Current))
     {
         space_info *Space = GetActiveSpaceOfScreen(KWMScreen.Current);
-        tree_node *Node = GetNodeFromWindowID(Space->RootNode, Window->WID, Space->Mode);
+        tree_node *Node = GetNodeFromWindowID(Space, Window->WID);
         if(Node)
             ResizeWindowToContainerSize(Node);
     }
@@ -1709,7 +2094,7 @@ void ModifySubtreeSplitRatioFromWindow(const double &Offset)
         if(IsLeafNode(Root) || Root->WindowID != -1)
             return;
 
-        tree_node *Node = GetNodeFromWindowID(Root, KWMFocus.Window->WID, Space->Mode);
+        tree_node *Node = GetNodeFromWindowID(Space, KWMFocus.Window->WID);
         ModifySubtreeSplitRatio(KWMScreen.Current, Node, Offset);
     }
 }
@@ -24,6 +24,39 @@ bool GetWindowFocusedByOSX(int *WindowWID);
 int GetFocusedWindowID();
 bool FocusWindowOfOSX();
 void FocusWindowBelowCursor();
+void FocusWindowBelowCursor(CGPoint Cursor);
+void UpdateFocusedWindowCache(window_info *Window);
+
+/* Focus-follows-mouse for kCGEventMouseMoved. Events that arrive within
+   KWMFocus.MouseInterval of the last evaluated one only record the cursor,
+   CheckPendingMouseMove() evaluates the last position from the window
+   monitor once movement stops. A focus change to another window waits
+   until the cursor has stayed over it for KWMFocus.MouseDwell seconds.
+    Input:
+        Cursor - location of the mouse-move event
+    Output:
+        bool - true when the event was coalesced and needs no evaluation
+*/
+bool IsMouseMoveCoalesced(CGPoint Cursor);
+bool IsFocusChangeDeferred(window_info *Window);
+void FocusWindowFollowingMouse(CGPoint Cursor);
+void CheckPendingMouseMove();
+
+/* Spatial index over the windows of KWMTiling.FocusLst that can gain focus.
+   The bounding box of the windows is cut into square cells, every cell lists
+   the windows overlapping it front to back. It is rebuilt together with
+   FocusLst by UpdateActiveWindowList(). A lookup only tests the windows of
+   one cell, and is skipped while the point stays inside the last hit and no
+   window in front of it overlaps it.
+    Input:
+        Point - position in screen coordinates
+    Output:
+        window_info* - topmost window at Point that can gain focus, or NULL
+*/
+void UpdateWindowFocusIndex();
+window_info *GetFocusTargetAtPoint(CGPoint Point);
+bool IsWindowFocusTarget(window_info *Window);
+bool IsPointInsideWindow(CGPoint Point, window_info *Window);
 void FocusFirstLeafNode();
 void FocusLastLeafNode();
 
@@ -35,6 +68,22 @@ void CreateWindowNodeTree(screen_info *Screen, std::vector<window_info*> *Window
 void ShouldWindowNodeTreeUpdate(screen_info *Screen);
 void AddWindowToTreeOfUnfocusedMonitor(screen_info *Screen, window_info *Window);
 
+/* Set difference between the windows indexed in the tree of a space and the
+   windows in KWMTiling.WindowLst. Windows missing from the tree are found
+   through Space->WindowNodes, floating windows and windows of floating
+   applications are never reported as added. Windows that left are only
+   searched for when fewer listed windows were found in the tree than it
+   holds. A window that closes while another opens in the same tick is
+   caught even though the size of the list did not change.
+    Input:
+        Space - space whose tree is compared against the window list
+    Output:
+        Added - windows in the list that are not in the tree and do not float
+        Removed - ids of windows in the tree that are not in the list
+        bool - true if either set is non-empty
+*/
+bool GetWindowTreeChanges(space_info *Space, std::vector<window_info*> *Added, std::vector<int> *Removed);
+
 void ShouldBSPTreeUpdate(screen_info *Screen, space_info *Space);
 void AddWindowToBSPTree(screen_info *Screen, int WindowID);
 void AddWindowToBSPTree();
@@ -73,11 +122,36 @@ void SetWindowFocus(window_info *Window);
 void SetWindowFocusByNode(tree_node *Node);
 
 bool IsWindowNonResizable(AXUIElementRef WindowRef, window_info *Window, CFTypeRef NewWindowPos, CFTypeRef NewWindowSize);
-void CenterWindowInsideNodeContainer(AXUIElementRef WindowRef, int *Xptr, int *Yptr, int *Wptr, int *Hptr);
+void CenterWindowInsideNodeContainer(AXUIElementRef WindowRef, window_info *Window, int *Xptr, int *Yptr, int *Wptr, int *Hptr);
 
 void SetWindowDimensions(AXUIElementRef WindowRef, window_info *Window, int X, int Y, int Width, int Height);
 void CenterWindow(screen_info *Screen, window_info *Window);
 void MoveFloatingWindow(int X, int Y);
+/* Last frame requested for a window and the frame it held afterwards, as
+   reported by the first window list after the resize; UpdateWindowFrameCache()
+   fills it in, so caching a frame costs no AX call. ResizeWindowToContainerSize(tree_node*)
+   skips the AX calls when the rounded target is unchanged and the window
+   still reports that frame. */
+bool IsWindowFrameApplied(window_info *Window, const window_frame &Target);
+void CacheWindowFrame(window_info *Window, const window_frame &Target);
+void UpdateWindowFrameCache();
+void ClearWindowFrameCache(int WindowID);
+void ClearWindowFrameCache();
+
+/* Size constraints learned per window from the frame it reports after a
+   resize, and the result of the resizability probe of float-non-resizable.
+   A new window starts with the minimum size last seen for its application.
+   Known maximum sizes center the target frame before it is applied, until
+   the container grows past the size the window refused and the window is
+   asked for the full container again. Known minimum sizes are used by
+   GetConstrainedSplitRatio() during layout. */
+window_constraint *GetWindowConstraint(window_info *Window);
+void ClearWindowConstraint(int WindowID);
+void UpdateWindowConstraint(int *Min, int *Max, int *Refused, int Requested, int Reported);
+void LearnWindowConstraint(window_info *Window, int Width, int Height, int ReportedWidth, int ReportedHeight);
+bool IsWindowResizable(window_info *Window);
+void ApplyWindowConstraint(window_info *Window, window_frame *Target);
+
 void ResizeWindowToContainerSize(tree_node *Node);
 void ResizeWindowToContainerSize(window_info *Window);
 void ResizeWindowToContainerSize();
@@ -64,11 +64,15 @@ void ShowHelp(std::string Command)
             "   cycle-focus screen|all|disabled                        Set wrap-around for 'window -f prev|next'\n"
             "   focus mouse-follows enable|disable                     Set state of mouse-follows-focus\n"
             "   focus standby-on-float enable|disable                  Disables focus-follows-mouse when a floating window gains focus\n"
+            "   focus mouse-interval seconds                           Evaluate focus-follows-mouse at most once per interval (default: 0.02)\n"
+            "   focus mouse-dwell seconds                              Time the cursor must rest on a window before it gains focus (default: 0)\n"
             "   tiling enable|disable                                  Should Kwm perform tiling\n"
-            "   space bsp|monocle|float                                Set default tiling mode\n"
-            "   screen id bsp|monocle|float                            Override default tiling mode for screen\n"
+            "   space bsp|monocle|master|grid|float                    Set default tiling mode\n"
+            "   screen id bsp|monocle|master|grid|float                Override default tiling mode for screen\n"
             "   hotkeys enable|disable                                 Set state of Kwm's hotkeys\n"
             "   split-ratio value                                      Set split-ratio to use for containers (0 < value < 1, default: 0.5)\n"
+            "   master-count value                                     Set number of master windows in master spaces (default: 1)\n"
+            "   master-ratio value                                     Set width of the master column in master spaces (0 < value < 1, default: 0.5)\n"
             "   add-role role application\n"
             "        Add custom role for which windows Kwm should tile.\n"
             "        To find the role of a window that Kwm doesn't tile, use the OSX Accessibility Inspector utility.\n"
@@ -110,8 +114,12 @@ void ShowHelp(std::string Command)
             "Options:\n"
             "   -r 90|180|270                                          Rotate window-tree\n"
             "   -c refresh                                             Resize all windows to container\n"
+            "   equalize                                               Give every window of the bsp-tree the same area\n"
+            "   rebalance                                              Rebuild the bsp-tree with minimum depth, keeping window order\n"
             "   save name                                              Save current bsp-tree to file ($HOME/.kwm/name)\n"
             "   restore name                                           Load current bsp-tree from file ($HOME/.kwm/layouts/name)\n"
+            "   undo                                                   Revert the last layout change of the bsp-tree\n"
+            "   redo                                                   Reapply the last reverted layout change\n"
         ;
     }
     else if (Command ==  "space")
@@ -120,7 +128,7 @@ void ShowHelp(std::string Command)
             "Usage: kwmc space <options>\n"
             "\n"
             "Options:\n"
-            "   -t toggle|bsp|monocle|float                             Set tiling mode of current space (every space uses bsp tiling by default)\n"
+            "   -t toggle|bsp|monocle|master|grid|float                 Set tiling mode of current space (every space uses bsp tiling by default)\n"
             "   -p increase|decrease left|right|top|bottom              Change space padding\n"
             "   -g increase|decrease vertical|horizontal                Change space container gaps\n"
             "   -s id num                                               Change space of current display (System Preferences->Keyboard->Shortcuts for spaces must be enabled!)\n"
@@ -159,8 +167,11 @@ void ShowHelp(std::string Command)
             "   split-mode global                                      Get the current mode used for binary splits\n"
             "   split-mode windowid                                    Get the split-mode used for the given window\n"
             "   split-ratio                                            Get the current ratio used for binary splits\n"
+            "   master-count                                           Get the number of master windows in master spaces\n"
+            "   master-ratio                                           Get the width of the master column in master spaces\n"
             "   border focused|marked|prefix                           Get the state of border->enable\n"
             "   windows                                                Get list of visible windows on active space\n"
+            "   stats                                                  Get node-pool, window-resize and mouse-focus counters\n"
         ;
     }
     else